@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <iomanip>
 #include <sstream>
+#include <thread>
 #include <openssl/sha.h>
 
 // APSI headers
@@ -220,7 +221,7 @@ public:
 
         try {
             // Set APSI environment
-            ThreadPoolMgr::SetThreadCount(8); // Increased threads
+            ThreadPoolMgr::SetThreadCount(max(1u, thread::hardware_concurrency()));
             Log::SetLogLevel(Log::Level::info);
 
             // Create communication channel
@@ -1,6 +1,7 @@
 // encode_data.cpp
 // 对IP数据进行前缀编码：Receiver前缀展开，Sender通配符填充
 // 支持多个delta值：10, 50, 250
+// --multi-tier: 生成带δ标签的合并数据，APSI单次查询即可得到每个元素的最小匹配δ
 
 #include <iostream>
 #include <vector>
@@ -14,6 +15,7 @@
 #include <bitset>
 #include <sstream>
 #include <filesystem>
+#include <map>
 
 struct IPData {
     uint32_t ip;
@@ -532,6 +534,122 @@ public:
         }
     }
     
+    // 多档位模式的条目标签：<δ>:<前缀>，保证不同δ档位的前缀互不匹配
+    static std::string make_tier_item(int delta, const std::string& prefix) {
+        return std::to_string(delta) + ":" + prefix;
+    }
+    
+    // 保存多档位APSI数据：所有δ档位的Sender前缀合并进一个SenderDB输入，
+    // Receiver查询同样合并，并保留 标签前缀 -> IP 的映射用于回溯最小匹配δ
+    void save_multi_tier_apsi_data(
+        const std::vector<IPData>& receiver_data,
+        const std::map<int, std::unordered_map<uint32_t, std::vector<std::string>>>& receiver_encoded_by_delta,
+        const std::map<int, std::unordered_map<uint32_t, std::vector<std::string>>>& sender_encoded_by_delta,
+        const std::string& sender_size_exp) {
+        
+        std::string output_dir = "/home/luck/xzy/intPSI/APSI_Test/prefixdata";
+        std::filesystem::create_directories(output_dir);
+        
+        std::unordered_set<std::string> all_receiver_items;
+        std::unordered_set<std::string> all_sender_items;
+        
+        // 保存Receiver映射 (同一标签前缀可能对应多个IP，每行一个)
+        std::string mapping_file = output_dir + "/receiver_prefix_to_ip_multi.txt";
+        std::ofstream mapping_out(mapping_file);
+        mapping_out << "# 多档位Receiver映射: <δ>:<前缀> -> IP\n\n";
+        
+        for (const auto& tier : receiver_encoded_by_delta) {
+            int delta = tier.first;
+            for (const auto& data : receiver_data) {
+                auto it = tier.second.find(data.ip);
+                if (it == tier.second.end()) continue;
+                for (const auto& prefix : it->second) {
+                    std::string item = make_tier_item(delta, prefix);
+                    all_receiver_items.insert(item);
+                    mapping_out << item << " -> " << data.ip << "\n";
+                }
+            }
+        }
+        mapping_out.close();
+        
+        for (const auto& tier : sender_encoded_by_delta) {
+            for (const auto& pair : tier.second) {
+                for (const auto& prefix : pair.second) {
+                    all_sender_items.insert(make_tier_item(tier.first, prefix));
+                }
+            }
+        }
+        
+        std::string receiver_items_file = output_dir + "/receiver_items_multi.txt";
+        std::ofstream receiver_items(receiver_items_file);
+        receiver_items << "# APSI格式多档位Receiver数据 (<δ>:<前缀>)\n";
+        receiver_items << "# 总计 " << all_receiver_items.size() << " 个唯一条目\n\n";
+        for (const auto& item : all_receiver_items) {
+            receiver_items << item << "\n";
+        }
+        receiver_items.close();
+        
+        std::string sender_items_file = output_dir + "/sender_items_2e" + sender_size_exp + "_multi.txt";
+        std::ofstream sender_items(sender_items_file);
+        sender_items << "# APSI格式多档位Sender数据 (<δ>:<前缀>)\n";
+        sender_items << "# 总计 " << all_sender_items.size() << " 个唯一条目\n\n";
+        for (const auto& item : all_sender_items) {
+            sender_items << item << "\n";
+        }
+        sender_items.close();
+        
+        std::cout << "✓ " << receiver_items_file << " - 多档位Receiver数据 ("
+                  << all_receiver_items.size() << " 条)" << std::endl;
+        std::cout << "✓ " << sender_items_file << " - 多档位Sender数据 ("
+                  << all_sender_items.size() << " 条)" << std::endl;
+        std::cout << "✓ " << mapping_file << " - 多档位Receiver映射" << std::endl;
+    }
+    
+    // 多档位模式：每个sender规模生成一份包含全部δ档位的数据，APSI只需执行一次
+    void process_multi_tier_datasets() {
+        std::string input_dir = "/home/luck/xzy/intPSI/APSI_Test/data";
+        
+        std::cout << "=== 多档位IP数据编码器 ===" << std::endl;
+        std::cout << "输入目录: " << input_dir << std::endl;
+        
+        auto receiver_data = read_csv_file(input_dir + "/receiver_query.csv");
+        if (receiver_data.empty()) {
+            std::cerr << "错误: 无法读取receiver数据！" << std::endl;
+            return;
+        }
+        
+        std::vector<int> sender_sizes = {12, 14, 16, 18, 20, 22}; // 2^n的指数
+        
+        // Receiver编码与sender规模无关，每个δ只编码一次
+        std::map<int, std::unordered_map<uint32_t, std::vector<std::string>>> receiver_encoded_by_delta;
+        for (const auto& config : delta_configs) {
+            receiver_encoded_by_delta[config.delta] = encode_receiver_data(receiver_data, config.delta);
+        }
+        
+        for (int size_exp : sender_sizes) {
+            std::cout << "\n--- 处理Sender 2^" << size_exp << " (全部δ档位) ---" << std::endl;
+            
+            std::map<int, std::unordered_map<uint32_t, std::vector<std::string>>> sender_encoded_by_delta;
+            for (const auto& config : delta_configs) {
+                std::string sender_file = input_dir + "/sender_db_2e" + std::to_string(size_exp) + 
+                                        "_delta_" + std::to_string(config.delta) + ".csv";
+                auto sender_data = read_csv_file(sender_file);
+                if (sender_data.empty()) {
+                    std::cerr << "警告: 无法读取sender数据: " << sender_file << std::endl;
+                    continue;
+                }
+                sender_encoded_by_delta[config.delta] = encode_sender_data(sender_data, config.delta);
+            }
+            
+            if (sender_encoded_by_delta.empty()) continue;
+            
+            save_multi_tier_apsi_data(receiver_data, receiver_encoded_by_delta, 
+                                      sender_encoded_by_delta, std::to_string(size_exp));
+        }
+        
+        std::cout << "\n=== 多档位编码完成 ===" << std::endl;
+    }
+    
     // 处理所有数据集
     void process_all_datasets() {
         std::string input_dir = "/home/luck/xzy/intPSI/APSI_Test/data";
@@ -598,10 +716,14 @@ public:
     }
 };
 
-int main() {
+int main(int argc, char* argv[]) {
     try {
         MultiDeltaPrefixEncoder encoder;
-        encoder.process_all_datasets();
+        if (argc > 1 && std::string(argv[1]) == "--multi-tier") {
+            encoder.process_multi_tier_datasets();
+        } else {
+            encoder.process_all_datasets();
+        }
         return 0;
         
     } catch (const std::exception& e) {
@@ -2,6 +2,7 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#include <map>
 #include <unordered_map>
 #include <unordered_set>
 #include <memory>
@@ -9,7 +10,26 @@
 #include <algorithm>
 #include <iomanip>
 #include <sstream>
+#include <array>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <list>
+#include <csignal>
 #include <openssl/sha.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/syscall.h>
 
 // APSI headers
 #include "apsi/log.h"
@@ -33,6 +53,174 @@ using namespace apsi::receiver;
 using namespace apsi::network;
 using namespace seal;
 
+// 运行选项
+struct RunOptions {
+    bool multi_threshold = false;   // 单次查询评估所有δ档位 (数据来自 prefixencode --multi-tier)
+    string oprf_key_file;           // Sender OPRF密钥持久化文件，为空则每次运行随机生成
+    bool rotate_oprf_key = false;   // 启动时强制Sender生成新密钥（使所有receiver缓存失效）；服务运行中用SIGUSR1轮换
+    string oprf_cache_file;         // Receiver OPRF结果缓存文件，为空则不使用缓存
+    size_t query_slice_size = 0;    // 每个子查询的条目数，0表示按cuckoo表容量自动选择
+    size_t max_concurrent_queries = 4;  // 同时进行的子查询数
+    string serve_socket;            // Sender常驻服务模式：监听的Unix域套接字路径
+    string connect_socket;          // Receiver客户端模式：连接到Sender服务
+    size_t service_workers = 4;     // Sender服务处理请求队列的工作线程数
+    string sender_items_file = "data/sender_items.txt";
+    string receiver_items_file = "data/receiver_items.txt";
+    size_t threads = 0;             // APSI线程池大小，0表示使用当前可用CPU数
+    string pin_cpus;                // 绑定的CPU列表，格式同 /sys cpulist，例如 "0-25,52-77"
+    int numa_node = -1;             // 绑定到指定NUMA节点的CPU和内存，-1表示不限制
+    bool scaling_bench = false;     // 线程扩展性基准：1,2,4,...,N 线程下的建库和查询时间
+};
+
+RunOptions parse_run_options(int argc, char* argv[]) {
+    RunOptions options;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--multi-threshold") {
+            options.multi_threshold = true;
+        } else if (arg == "--oprf-key" && i + 1 < argc) {
+            options.oprf_key_file = argv[++i];
+        } else if (arg == "--rotate-oprf-key") {
+            options.rotate_oprf_key = true;
+        } else if (arg == "--oprf-cache" && i + 1 < argc) {
+            options.oprf_cache_file = argv[++i];
+        } else if (arg == "--query-slice-size" && i + 1 < argc) {
+            options.query_slice_size = stoul(argv[++i]);
+        } else if (arg == "--max-concurrent-queries" && i + 1 < argc) {
+            options.max_concurrent_queries = stoul(argv[++i]);
+        } else if (arg == "--serve" && i + 1 < argc) {
+            options.serve_socket = argv[++i];
+        } else if (arg == "--connect" && i + 1 < argc) {
+            options.connect_socket = argv[++i];
+        } else if (arg == "--service-workers" && i + 1 < argc) {
+            options.service_workers = max<size_t>(1, stoul(argv[++i]));
+        } else if (arg == "--sender-items" && i + 1 < argc) {
+            options.sender_items_file = argv[++i];
+        } else if (arg == "--receiver-items" && i + 1 < argc) {
+            options.receiver_items_file = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = stoul(argv[++i]);
+        } else if (arg == "--pin-cpus" && i + 1 < argc) {
+            options.pin_cpus = argv[++i];
+        } else if (arg == "--numa-node" && i + 1 < argc) {
+            options.numa_node = stoi(argv[++i]);
+        } else if (arg == "--scaling-bench") {
+            options.scaling_bench = true;
+        } else {
+            cerr << "Unknown option: " << arg << endl;
+            cerr << "Usage: " << argv[0] << " [--multi-threshold] [--oprf-key <file>] [--rotate-oprf-key]"
+                 << " [--oprf-cache <file>] [--query-slice-size <n>] [--max-concurrent-queries <n>]"
+                 << " [--serve <socket> [--service-workers <n>] | --connect <socket>]"
+                 << " [--sender-items <file>] [--receiver-items <file>]"
+                 << " [--threads <n>] [--pin-cpus <list>] [--numa-node <id>] [--scaling-bench]" << endl;
+            exit(1);
+        }
+    }
+    // 本地Sender每次运行随机生成密钥时缓存永远不会命中；--connect模式的密钥由远端服务持有
+    if (!options.oprf_cache_file.empty() && options.oprf_key_file.empty() && options.connect_socket.empty()) {
+        cerr << "Error: --oprf-cache requires --oprf-key (or --connect to a sender service)" << endl;
+        exit(1);
+    }
+    return options;
+}
+
+// 解析cpulist格式的CPU列表，例如 "0-3,8,10-11"
+vector<int> parse_cpu_list(const string& list) {
+    vector<int> cpus;
+    stringstream ss(list);
+    string range;
+    while (getline(ss, range, ',')) {
+        if (range.empty() || range == "\n") continue;
+        size_t dash = range.find('-');
+        int first = stoi(range.substr(0, dash));
+        int last = (dash == string::npos) ? first : stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// 读取NUMA节点的CPU列表
+vector<int> read_numa_cpus(int node) {
+    ifstream file("/sys/devices/system/node/node" + to_string(node) + "/cpulist");
+    string list;
+    if (!file || !getline(file, list)) {
+        return {};
+    }
+    return parse_cpu_list(list);
+}
+
+// 当前线程亲和性掩码中的CPU数
+size_t available_cpu_count() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        return CPU_COUNT(&set);
+    }
+    return max(1u, thread::hardware_concurrency());
+}
+
+// 按 --pin-cpus / --numa-node 设置主线程CPU亲和性和内存策略。
+// 必须在APSI线程池创建工作线程之前调用：新线程继承创建者的亲和性。
+bool apply_cpu_topology(const RunOptions& options) {
+    static constexpr int MPOL_BIND_MODE = 2;
+    
+    vector<int> cpus;
+    if (options.numa_node >= 0) {
+        cpus = read_numa_cpus(options.numa_node);
+        if (cpus.empty()) {
+            cerr << "Error: NUMA node " << options.numa_node << " not found" << endl;
+            return false;
+        }
+    }
+    if (!options.pin_cpus.empty()) {
+        vector<int> pinned = parse_cpu_list(options.pin_cpus);
+        if (!cpus.empty()) {
+            // 同时指定时取交集
+            unordered_set<int> node_cpus(cpus.begin(), cpus.end());
+            pinned.erase(remove_if(pinned.begin(), pinned.end(), 
+                                   [&](int cpu) { return !node_cpus.count(cpu); }), pinned.end());
+        }
+        cpus = pinned;
+    }
+    
+    if (!cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+        }
+        if (CPU_COUNT(&set) == 0 || sched_setaffinity(0, sizeof(set), &set) != 0) {
+            cerr << "Error: cannot pin to CPUs " << options.pin_cpus << ": " << strerror(errno) << endl;
+            return false;
+        }
+        cout << "Pinned to " << CPU_COUNT(&set) << " CPUs" << endl;
+    }
+    
+    if (options.numa_node >= 0) {
+        // 内存只从该节点分配，避免SenderDB跨节点访问
+        unsigned long nodemask[4] = {0, 0, 0, 0};
+        size_t max_node = sizeof(nodemask) * 8;
+        if (static_cast<size_t>(options.numa_node) >= max_node) {
+            cerr << "Error: NUMA node id too large" << endl;
+            return false;
+        }
+        nodemask[options.numa_node / 64] |= 1UL << (options.numa_node % 64);
+        if (syscall(SYS_set_mempolicy, MPOL_BIND_MODE, nodemask, max_node + 1) != 0) {
+            cerr << "Warning: set_mempolicy failed (" << strerror(errno) << "), memory is not node-local" << endl;
+        } else {
+            cout << "Memory bound to NUMA node " << options.numa_node << endl;
+        }
+    }
+    return true;
+}
+
+// APSI线程池大小：显式指定优先，否则取亲和性范围内的CPU数
+size_t resolve_thread_count(const RunOptions& options) {
+    return options.threads > 0 ? options.threads : available_cpu_count();
+}
+
 // 通信量统计结构
 struct CommunicationStats {
     size_t oprf_receiver_to_sender = 0;
@@ -100,17 +288,17 @@ public:
     CommunicationStatsHelper(CommunicationStats* stats, size_t receiver_count, size_t poly_degree)
         : comm_stats_(stats), receiver_item_count_(receiver_count), poly_degree_(poly_degree) {}
     
-    void record_oprf_request() {
-        // OPRF请求：每个椭圆曲线点约32字节
-        size_t size = receiver_item_count_ * 32;
-        comm_stats_->oprf_receiver_to_sender = size;
+    void record_oprf_request(size_t item_count) {
+        // OPRF请求：每个椭圆曲线点约32字节（缓存命中的条目不发送）
+        size_t size = item_count * 32;
+        comm_stats_->oprf_receiver_to_sender += size;
         cout << "[COMM] Receiver -> Sender (OPRF Request): " << size << " bytes" << endl;
     }
     
-    void record_oprf_response() {
+    void record_oprf_response(size_t item_count) {
         // OPRF响应：每个椭圆曲线点约32字节
-        size_t size = receiver_item_count_ * 32;
-        comm_stats_->oprf_sender_to_receiver = size;
+        size_t size = item_count * 32;
+        comm_stats_->oprf_sender_to_receiver += size;
         cout << "[COMM] Sender -> Receiver (OPRF Response): " << size << " bytes" << endl;
     }
     
@@ -118,7 +306,7 @@ public:
         // PSI查询：基于密文数量和大小
         size_t ciphertext_size = poly_degree_ * 4 * 8; // 基于SEAL参数
         size_t size = num_ciphertexts * ciphertext_size;
-        comm_stats_->psi_receiver_to_sender = size;
+        comm_stats_->psi_receiver_to_sender += size;
         cout << "[COMM] Receiver -> Sender (PSI Query): " << size << " bytes (" 
              << num_ciphertexts << " ciphertexts)" << endl;
     }
@@ -127,7 +315,7 @@ public:
         // PSI响应：基于结果包数量
         size_t ciphertext_size = poly_degree_ * 4 * 8;
         size_t size = package_count * ciphertext_size;
-        comm_stats_->psi_sender_to_receiver = size;
+        comm_stats_->psi_sender_to_receiver += size;
         cout << "[COMM] Sender -> Receiver (PSI Response): " << size << " bytes (" 
              << package_count << " packages)" << endl;
     }
@@ -165,11 +353,559 @@ public:
     }
 };
 
+// Receiver端OPRF结果缓存
+// 以 (Item, Sender OPRF密钥指纹) 为键保存 HashedItem 和 LabelKey，持久化到磁盘。
+// 指纹不一致说明Sender已轮换密钥，加载时整个缓存作废。
+// 指纹由金丝雀条目的OPRF值导出，进程内与远程receiver得到的结果一致。
+class OPRFResultCache {
+public:
+    using KeyFingerprint = array<unsigned char, SHA256_DIGEST_LENGTH>;
+
+    explicit OPRFResultCache(string filename) : filename_(std::move(filename)) {}
+
+    // 固定的金丝雀条目：其OPRF值只取决于Sender密钥，receiver无需看到密钥即可识别密钥轮换
+    static Item canary_item() {
+        return Item(0x7972616e61632d69ULL, 0x66727063616e6172ULL);
+    }
+
+    // 密钥标识：金丝雀条目OPRF值的SHA256
+    static KeyFingerprint fingerprint(const HashedItem& canary_hash) {
+        KeyFingerprint digest;
+        SHA256(canary_hash.value().data(), canary_hash.value().size(), digest.data());
+        return digest;
+    }
+
+    void load(const KeyFingerprint& key_id) {
+        PrecisionTimer timer("OPRF Cache Load");
+        
+        entries_.clear();
+        key_id_ = key_id;
+        dirty_ = false;
+        
+        ifstream file(filename_, ios::binary);
+        if (!file) {
+            cout << "OPRF cache " << filename_ << " not found, starting empty" << endl;
+            return;
+        }
+        
+        char magic[sizeof(MAGIC)];
+        uint32_t version = 0;
+        KeyFingerprint stored_id;
+        uint64_t count = 0;
+        file.read(magic, sizeof(magic));
+        file.read(reinterpret_cast<char*>(&version), sizeof(version));
+        file.read(reinterpret_cast<char*>(stored_id.data()), stored_id.size());
+        file.read(reinterpret_cast<char*>(&count), sizeof(count));
+        if (!file || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || version != VERSION) {
+            cout << "OPRF cache " << filename_ << " has an unknown format, discarding" << endl;
+            dirty_ = true;
+            return;
+        }
+        if (stored_id != key_id) {
+            cout << "Sender OPRF key changed, invalidating " << filename_ << endl;
+            dirty_ = true;
+            return;
+        }
+        
+        entries_.reserve(count);
+        for (uint64_t i = 0; i < count; i++) {
+            Item::value_type item;
+            Entry entry;
+            file.read(reinterpret_cast<char*>(item.data()), item.size());
+            file.read(reinterpret_cast<char*>(entry.hashed.data()), entry.hashed.size());
+            file.read(reinterpret_cast<char*>(entry.label_key.data()), entry.label_key.size());
+            if (!file) break;
+            entries_.emplace(item, entry);
+        }
+        cout << "Loaded " << entries_.size() << " cached OPRF results from " << filename_ << endl;
+    }
+
+    bool lookup(const Item& item, HashedItem& hashed, LabelKey& label_key) const {
+        auto it = entries_.find(item.value());
+        if (it == entries_.end()) return false;
+        hashed = HashedItem(it->second.hashed);
+        label_key = it->second.label_key;
+        return true;
+    }
+
+    void insert(const Item& item, const HashedItem& hashed, const LabelKey& label_key) {
+        entries_[item.value()] = Entry{hashed.value(), label_key};
+        dirty_ = true;
+    }
+
+    void save() {
+        if (!dirty_) return;
+        PrecisionTimer timer("OPRF Cache Save");
+        
+        // 先写临时文件再改名，避免中断时留下损坏的缓存
+        string tmp_filename = filename_ + ".tmp";
+        ofstream file(tmp_filename, ios::binary | ios::trunc);
+        uint64_t count = entries_.size();
+        file.write(MAGIC, sizeof(MAGIC));
+        file.write(reinterpret_cast<const char*>(&VERSION), sizeof(VERSION));
+        file.write(reinterpret_cast<const char*>(key_id_.data()), key_id_.size());
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& entry : entries_) {
+            file.write(reinterpret_cast<const char*>(entry.first.data()), entry.first.size());
+            file.write(reinterpret_cast<const char*>(entry.second.hashed.data()), entry.second.hashed.size());
+            file.write(reinterpret_cast<const char*>(entry.second.label_key.data()), entry.second.label_key.size());
+        }
+        file.close();
+        if (!file || rename(tmp_filename.c_str(), filename_.c_str()) != 0) {
+            cerr << "Failed to write OPRF cache " << filename_ << endl;
+            return;
+        }
+        dirty_ = false;
+        cout << "Saved " << count << " OPRF results to " << filename_ << endl;
+    }
+
+private:
+    static constexpr char MAGIC[8] = {'A', 'P', 'S', 'I', 'O', 'P', 'R', 'F'};
+    static constexpr uint32_t VERSION = 1;
+
+    struct Entry {
+        Item::value_type hashed;
+        LabelKey label_key;
+    };
+
+    // Item本身是SHA256输出，直接取低64位作为哈希
+    struct ItemValueHash {
+        size_t operator()(const Item::value_type& value) const {
+            uint64_t word;
+            memcpy(&word, value.data(), sizeof(word));
+            return static_cast<size_t>(word);
+        }
+    };
+
+    string filename_;
+    KeyFingerprint key_id_{};
+    bool dirty_ = false;
+    unordered_map<Item::value_type, Entry, ItemValueHash> entries_;
+};
+
+// 基于文件描述符的流缓冲区，使APSI的StreamChannel可以直接跑在套接字上
+class FdStreamBuf : public streambuf {
+public:
+    explicit FdStreamBuf(int fd) : fd_(fd) {
+        setg(in_buf_.data(), in_buf_.data(), in_buf_.data());
+        setp(out_buf_.data(), out_buf_.data() + out_buf_.size());
+    }
+
+protected:
+    int_type underflow() override {
+        ssize_t n;
+        do {
+            n = ::read(fd_, in_buf_.data(), in_buf_.size());
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) return traits_type::eof();
+        setg(in_buf_.data(), in_buf_.data(), in_buf_.data() + n);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    int_type overflow(int_type ch) override {
+        if (!flush_output()) return traits_type::eof();
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override {
+        return flush_output() ? 0 : -1;
+    }
+
+private:
+    bool flush_output() {
+        const char* data = pbase();
+        size_t remaining = pptr() - pbase();
+        while (remaining > 0) {
+            ssize_t n = ::send(fd_, data, remaining, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            remaining -= n;
+        }
+        setp(out_buf_.data(), out_buf_.data() + out_buf_.size());
+        return true;
+    }
+
+    int fd_;
+    array<char, 1 << 16> in_buf_;
+    array<char, 1 << 16> out_buf_;
+};
+
+// 连接到Sender服务的Unix域套接字，失败返回-1
+int connect_unix_socket(const string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// 服务模式的信号标志：SIGINT/SIGTERM 停止服务，SIGHUP 重新加载Sender数据（沿用当前OPRF密钥），
+// SIGUSR1 重新加载并轮换OPRF密钥
+static volatile sig_atomic_t g_service_stop = 0;
+static volatile sig_atomic_t g_service_reload = 0;
+static volatile sig_atomic_t g_service_rotate_key = 0;
+
+extern "C" void handle_service_signal(int sig) {
+    if (sig == SIGHUP) {
+        g_service_reload = 1;
+    } else if (sig == SIGUSR1) {
+        g_service_rotate_key = 1;
+    } else {
+        g_service_stop = 1;
+    }
+}
+
+// 常驻Sender服务
+// SenderDB只构建一次并常驻内存；每个receiver连接由一个读线程接收请求并放入队列，
+// 工作线程按到达顺序处理OPRF/查询请求，查询内部仍使用APSI线程池并行计算。
+// 同一连接上的请求按顺序处理（读线程等待当前请求完成后再读取下一个）。
+// 一次receiver会话的参数、OPRF和各切片查询分属不同请求，重新加载必须沿用同一OPRF密钥，
+// 否则在两次请求之间重新加载会让查询与OPRF使用不同密钥，得到错误（通常为空）的交集而不报错。
+class SenderService {
+public:
+    // 用给定OPRF密钥重新构建SenderDB；rotated表示这是一个新生成的密钥
+    using DBBuilder = function<shared_ptr<SenderDB>(const oprf::OPRFKey& key, bool rotated)>;
+
+    SenderService(string socket_path, size_t worker_count, shared_ptr<SenderDB> sender_db, DBBuilder rebuild_db)
+        : socket_path_(std::move(socket_path)), worker_count_(worker_count),
+          sender_db_(std::move(sender_db)), rebuild_db_(std::move(rebuild_db)) {}
+
+    // 阻塞运行直到收到SIGINT/SIGTERM
+    void run() {
+        int listen_fd = open_listener();
+        if (listen_fd < 0) return;
+
+        signal(SIGINT, handle_service_signal);
+        signal(SIGTERM, handle_service_signal);
+        signal(SIGHUP, handle_service_signal);
+        signal(SIGUSR1, handle_service_signal);
+
+        vector<thread> workers;
+        for (size_t i = 0; i < worker_count_; i++) {
+            workers.emplace_back([this]() { worker_loop(); });
+        }
+        cout << "Sender service listening on " << socket_path_ << " with " << worker_count_ 
+             << " workers (SIGHUP reloads data, SIGUSR1 reloads with a new OPRF key, SIGINT stops)" << endl;
+
+        while (!g_service_stop) {
+            pollfd pfd{listen_fd, POLLIN, 0};
+            int ready = poll(&pfd, 1, SERVICE_POLL_INTERVAL_MS);
+            if (g_service_rotate_key) {
+                g_service_rotate_key = 0;
+                g_service_reload = 0;
+                reload_sender_db(true);
+            } else if (g_service_reload) {
+                g_service_reload = 0;
+                reload_sender_db(false);
+            }
+            reap_connections();
+            if (ready <= 0 || !(pfd.revents & POLLIN)) continue;
+
+            int client_fd = accept(listen_fd, nullptr, nullptr);
+            if (client_fd < 0) continue;
+            auto conn = make_shared<Connection>(client_fd, next_connection_id_++);
+            lock_guard<mutex> lock(connections_mutex_);
+            connections_.push_back({conn, thread([this, conn]() { reader_loop(conn); })});
+        }
+
+        cout << "Sender service stopping..." << endl;
+        close(listen_fd);
+        unlink(socket_path_.c_str());
+
+        // 先断开所有连接让读线程退出，已入队的请求由工作线程处理完
+        {
+            lock_guard<mutex> lock(connections_mutex_);
+            for (auto& entry : connections_) {
+                shutdown(entry.conn->fd, SHUT_RDWR);
+            }
+        }
+        for (auto& entry : connections_) {
+            entry.reader.join();
+        }
+        connections_.clear();
+        {
+            lock_guard<mutex> lock(queue_mutex_);
+            stopping_ = true;
+        }
+        queue_cv_.notify_all();
+        for (auto& t : workers) {
+            t.join();
+        }
+
+        print_metrics(cout);
+        system("mkdir -p results");
+        ofstream metrics_file("results/sender_service_metrics.txt");
+        print_metrics(metrics_file);
+    }
+
+private:
+    static constexpr int SERVICE_POLL_INTERVAL_MS = 200;
+    static constexpr int SERVICE_LISTEN_BACKLOG = 64;
+
+    struct Connection {
+        Connection(int fd_in, size_t id_in) 
+            : fd(fd_in), id(id_in), buf(fd_in), stream(&buf), channel(stream) {}
+        ~Connection() { close(fd); }
+
+        int fd;
+        size_t id;
+        FdStreamBuf buf;
+        iostream stream;
+        StreamChannel channel;
+        atomic<bool> closed{false};
+        bool failed = false;
+    };
+
+    struct ConnectionEntry {
+        shared_ptr<Connection> conn;
+        thread reader;
+    };
+
+    struct PendingRequest {
+        shared_ptr<Connection> conn;
+        unique_ptr<SenderOperation> op;
+        shared_ptr<SenderDB> sender_db;     // 入队时的数据库快照，重新加载不影响进行中的请求
+        chrono::high_resolution_clock::time_point enqueued;
+        promise<void> done;
+    };
+
+    // 每类请求的延迟样本 (ms)
+    struct LatencySamples {
+        vector<double> queue_wait;
+        vector<double> processing;
+    };
+
+    int open_listener() {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            cerr << "Error: cannot create socket: " << strerror(errno) << endl;
+            return -1;
+        }
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, socket_path_.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(socket_path_.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || 
+            listen(fd, SERVICE_LISTEN_BACKLOG) < 0) {
+            cerr << "Error: cannot listen on " << socket_path_ << ": " << strerror(errno) << endl;
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    shared_ptr<SenderDB> current_db() {
+        lock_guard<mutex> lock(db_mutex_);
+        return sender_db_;
+    }
+
+    // rotate_key为false时新SenderDB沿用当前OPRF密钥，进行中的会话和receiver缓存都保持有效；
+    // 为true时生成新密钥，所有进行中的会话会得到错误结果，receiver缓存全部失效
+    void reload_sender_db(bool rotate_key) {
+        cout << "Reloading sender data..." << endl;
+        try {
+            oprf::OPRFKey key = current_db()->get_oprf_key();
+            if (rotate_key) {
+                key = oprf::OPRFKey();
+                cerr << "Warning: rotating the OPRF key; in-flight receiver sessions will get wrong results"
+                     << " and must be restarted" << endl;
+            }
+            auto new_db = rebuild_db_(key, rotate_key);
+            if (!new_db) {
+                cerr << "Reload failed, keeping current SenderDB" << endl;
+                return;
+            }
+            lock_guard<mutex> lock(db_mutex_);
+            sender_db_ = std::move(new_db);
+            cout << "SenderDB swapped" << endl;
+        } catch (const exception& e) {
+            cerr << "Reload failed, keeping current SenderDB: " << e.what() << endl;
+        }
+    }
+
+    // 回收已断开连接的读线程
+    void reap_connections() {
+        lock_guard<mutex> lock(connections_mutex_);
+        for (auto it = connections_.begin(); it != connections_.end();) {
+            if (it->conn->closed) {
+                it->reader.join();
+                it = connections_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void reader_loop(shared_ptr<Connection> conn) {
+        while (!g_service_stop && !conn->failed) {
+            auto sender_db = current_db();
+            unique_ptr<SenderOperation> op;
+            try {
+                op = conn->channel.receive_operation(sender_db->get_seal_context());
+            } catch (const exception&) {
+                op = nullptr;
+            }
+            if (!op) break;   // 对端关闭或数据无效
+
+            auto request = make_unique<PendingRequest>();
+            request->conn = conn;
+            request->op = std::move(op);
+            request->sender_db = std::move(sender_db);
+            request->enqueued = chrono::high_resolution_clock::now();
+            future<void> done = request->done.get_future();
+            {
+                lock_guard<mutex> lock(queue_mutex_);
+                queue_.push_back(std::move(request));
+            }
+            queue_cv_.notify_one();
+            done.wait();
+        }
+        conn->closed = true;
+    }
+
+    void worker_loop() {
+        while (true) {
+            unique_ptr<PendingRequest> request;
+            {
+                unique_lock<mutex> lock(queue_mutex_);
+                queue_cv_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+                if (queue_.empty()) return;
+                request = std::move(queue_.front());
+                queue_.pop_front();
+            }
+
+            auto start = chrono::high_resolution_clock::now();
+            SenderOperationType type = request->op->type();
+            Channel& channel = request->conn->channel;
+            try {
+                switch (type) {
+                case SenderOperationType::sop_parms:
+                    Sender::RunParams(to_params_request(std::move(request->op)), request->sender_db, channel);
+                    break;
+                case SenderOperationType::sop_oprf:
+                    Sender::RunOPRF(to_oprf_request(std::move(request->op)), 
+                                    request->sender_db->get_oprf_key(), channel);
+                    break;
+                case SenderOperationType::sop_query: {
+                    Query query(to_query_request(std::move(request->op)), request->sender_db);
+                    Sender::RunQuery(query, channel);
+                    break;
+                }
+                default:
+                    cerr << "Connection " << request->conn->id << ": unsupported operation" << endl;
+                    request->conn->failed = true;
+                    break;
+                }
+                request->conn->stream.flush();
+            } catch (const exception& e) {
+                cerr << "Connection " << request->conn->id << ": request failed: " << e.what() << endl;
+                request->conn->failed = true;
+            }
+            auto end = chrono::high_resolution_clock::now();
+
+            record_latency(type, chrono::duration_cast<chrono::microseconds>(start - request->enqueued).count() / 1000.0,
+                           chrono::duration_cast<chrono::microseconds>(end - start).count() / 1000.0);
+            request->done.set_value();
+        }
+    }
+
+    void record_latency(SenderOperationType type, double queue_wait_ms, double processing_ms) {
+        lock_guard<mutex> lock(metrics_mutex_);
+        auto& samples = metrics_[operation_name(type)];
+        samples.queue_wait.push_back(queue_wait_ms);
+        samples.processing.push_back(processing_ms);
+    }
+
+    static string operation_name(SenderOperationType type) {
+        switch (type) {
+        case SenderOperationType::sop_parms: return "params";
+        case SenderOperationType::sop_oprf: return "oprf";
+        case SenderOperationType::sop_query: return "query";
+        default: return "unknown";
+        }
+    }
+
+    static double percentile(vector<double> values, double p) {
+        if (values.empty()) return 0.0;
+        sort(values.begin(), values.end());
+        size_t index = min(values.size() - 1, static_cast<size_t>(p * (values.size() - 1) + 0.5));
+        return values[index];
+    }
+
+    void print_metrics(ostream& out) {
+        lock_guard<mutex> lock(metrics_mutex_);
+        out << "=== SENDER SERVICE METRICS ===" << endl;
+        out << "Connections served: " << next_connection_id_ << endl;
+        out << fixed << setprecision(3);
+        for (const auto& entry : metrics_) {
+            const auto& samples = entry.second;
+            out << entry.first << ": " << samples.processing.size() << " requests" << endl;
+            out << "  Queue wait (ms): p50=" << percentile(samples.queue_wait, 0.5)
+                << " p95=" << percentile(samples.queue_wait, 0.95)
+                << " max=" << percentile(samples.queue_wait, 1.0) << endl;
+            out << "  Processing (ms): p50=" << percentile(samples.processing, 0.5)
+                << " p95=" << percentile(samples.processing, 0.95)
+                << " max=" << percentile(samples.processing, 1.0) << endl;
+        }
+    }
+
+    string socket_path_;
+    size_t worker_count_;
+
+    mutex db_mutex_;
+    shared_ptr<SenderDB> sender_db_;
+    DBBuilder rebuild_db_;
+
+    mutex queue_mutex_;
+    condition_variable queue_cv_;
+    deque<unique_ptr<PendingRequest>> queue_;
+    bool stopping_ = false;
+
+    mutex connections_mutex_;
+    list<ConnectionEntry> connections_;
+    atomic<size_t> next_connection_id_{0};
+
+    mutex metrics_mutex_;
+    map<string, LatencySamples> metrics_;
+};
+
 class APSIDistancePSI {
 private:
     static constexpr int DELTA = 50;
+    static constexpr size_t QUERY_SLICE_LOAD_PERCENT = 75;  // 默认切片占cuckoo表容量的比例
+    RunOptions options_;
     CommunicationStats comm_stats_;
     OnlineTimeStats online_stats_;
+    unique_ptr<OPRFResultCache> oprf_cache_;
+
+    // Sender OPRF密钥：指定文件时跨运行复用，使receiver缓存保持有效
+    oprf::OPRFKey load_or_create_oprf_key() {
+        oprf::OPRFKey key;
+        if (!options_.rotate_oprf_key) {
+            ifstream key_in(options_.oprf_key_file, ios::binary);
+            if (key_in) {
+                key.load(key_in);
+                cout << "Loaded sender OPRF key from " << options_.oprf_key_file << endl;
+                return key;
+            }
+        }
+        
+        // OPRFKey构造时已随机生成
+        ofstream key_out(options_.oprf_key_file, ios::binary | ios::trunc);
+        key.save(key_out);
+        cout << "Generated new sender OPRF key in " << options_.oprf_key_file << endl;
+        return key;
+    }
 
     // 生成优化的SEAL参数
     string generate_valid_seal_params(size_t sender_size, size_t receiver_size) {
@@ -366,6 +1102,40 @@ private:
         return mapping;
     }
 
+    // 多档位映射：同一标签前缀可能属于多个receiver IP
+    unordered_map<string, vector<uint32_t>> read_multi_mapping_file(const string& filename) {
+        PrecisionTimer timer("Reading multi-tier mapping file: " + filename);
+        
+        unordered_map<string, vector<uint32_t>> mapping;
+        ifstream file(filename);
+        string line;
+        while (getline(file, line)) {
+            if (!line.empty() && line[0] != '#') {
+                size_t arrow_pos = line.find(" -> ");
+                if (arrow_pos != string::npos) {
+                    try {
+                        mapping[line.substr(0, arrow_pos)].push_back(stoul(line.substr(arrow_pos + 4)));
+                    } catch (...) {}
+                }
+            }
+        }
+        file.close();
+        
+        cout << "Read " << mapping.size() << " tagged prefixes from " << filename << endl;
+        return mapping;
+    }
+
+    // 解析多档位条目 "<δ>:<前缀>" 中的δ，格式不符返回-1
+    static int parse_tier_delta(const string& item) {
+        size_t colon_pos = item.find(':');
+        if (colon_pos == string::npos) return -1;
+        try {
+            return stoi(item.substr(0, colon_pos));
+        } catch (...) {
+            return -1;
+        }
+    }
+
     vector<uint32_t> read_ip_file(const string& filename) {
         PrecisionTimer timer("Reading IP file: " + filename);
         
@@ -385,6 +1155,248 @@ private:
         return ips;
     }
 
+    // 单个查询切片的结果
+    struct QuerySliceResult {
+        vector<bool> found;
+        size_t ciphertext_count = 0;
+        uint32_t package_count = 0;
+        double sender_time_ms = 0.0;   // Sender处理该切片查询的时间
+        double latency_ms = 0.0;       // 该切片从创建查询到得到结果的总时间
+    };
+
+    // Receiver发出请求后驱动Sender一侧，返回Sender处理时间(ms)。
+    // 进程内模式直接在同一通道上处理请求；远程模式只需刷新套接字。
+    using ServeSenderFn = function<double(Channel&)>;
+
+    // 切片大小：未指定时取receiver cuckoo表容量的 QUERY_SLICE_LOAD_PERCENT%
+    size_t query_slice_size(const PSIParams& params) const {
+        if (options_.query_slice_size > 0) return options_.query_slice_size;
+        size_t table_size = params.table_params().table_size;
+        return max<size_t>(1, table_size * QUERY_SLICE_LOAD_PERCENT / 100);
+    }
+
+    // 一次OPRF往返
+    pair<vector<HashedItem>, vector<LabelKey>> run_oprf_round_trip(Channel& channel,
+                                                                  const ServeSenderFn& serve_sender,
+                                                                  const vector<Item>& items) {
+        auto oprf_receiver = Receiver::CreateOPRFReceiver(items);
+        channel.send(Receiver::CreateOPRFRequest(oprf_receiver));
+        online_stats_.oprf_processing_time += serve_sender(channel);
+        
+        auto response = channel.receive_response();
+        auto oprf_response = to_oprf_response(response);
+        return Receiver::ExtractHashes(oprf_response, oprf_receiver);
+    }
+
+    // OPRF阶段：先查缓存，只有未命中的条目才走OPRF往返
+    pair<vector<HashedItem>, vector<LabelKey>> compute_receiver_oprf(const vector<Item>& receiver_items,
+                                                                    Channel& channel,
+                                                                    const ServeSenderFn& serve_sender,
+                                                                    CommunicationStatsHelper& comm_helper) {
+        PrecisionTimer timer("OPRF Phase");
+        
+        pair<vector<HashedItem>, vector<LabelKey>> receiver_oprf_items;
+        receiver_oprf_items.first.resize(receiver_items.size());
+        receiver_oprf_items.second.resize(receiver_items.size());
+        
+        vector<size_t> miss_indices;
+        vector<Item> miss_items;
+        if (oprf_cache_) {
+            auto canary = run_oprf_round_trip(channel, serve_sender, {OPRFResultCache::canary_item()});
+            comm_helper.record_oprf_request(1);
+            comm_helper.record_oprf_response(1);
+            oprf_cache_->load(OPRFResultCache::fingerprint(canary.first[0]));
+            timer.checkpoint("Sender key identified");
+            
+            for (size_t i = 0; i < receiver_items.size(); i++) {
+                if (!oprf_cache_->lookup(receiver_items[i], receiver_oprf_items.first[i], 
+                                         receiver_oprf_items.second[i])) {
+                    miss_indices.push_back(i);
+                    miss_items.push_back(receiver_items[i]);
+                }
+            }
+            cout << "OPRF cache: " << (receiver_items.size() - miss_items.size()) << " hits, " 
+                 << miss_items.size() << " misses" << endl;
+            timer.checkpoint("OPRF cache lookup");
+        } else {
+            miss_items = receiver_items;
+            for (size_t i = 0; i < receiver_items.size(); i++) miss_indices.push_back(i);
+        }
+        
+        if (!miss_items.empty()) {
+            // 记录OPRF请求/响应通信量
+            comm_helper.record_oprf_request(miss_items.size());
+            auto miss_oprf_items = run_oprf_round_trip(channel, serve_sender, miss_items);
+            comm_helper.record_oprf_response(miss_items.size());
+            timer.checkpoint("OPRF round trip completed");
+            
+            // 回填到原始位置
+            for (size_t j = 0; j < miss_indices.size(); j++) {
+                receiver_oprf_items.first[miss_indices[j]] = miss_oprf_items.first[j];
+                receiver_oprf_items.second[miss_indices[j]] = miss_oprf_items.second[j];
+                if (oprf_cache_) {
+                    oprf_cache_->insert(miss_items[j], miss_oprf_items.first[j], miss_oprf_items.second[j]);
+                }
+            }
+            timer.checkpoint("OPRF hashes extracted");
+            
+            if (oprf_cache_) {
+                oprf_cache_->save();
+                timer.checkpoint("OPRF cache saved");
+            }
+        }
+        
+        cout << "OPRF phase completed successfully" << endl;
+        return receiver_oprf_items;
+    }
+
+    // 在给定通道上执行一个查询切片
+    QuerySliceResult run_query_slice(const PSIParams& params,
+                                     Channel& channel,
+                                     const ServeSenderFn& serve_sender,
+                                     const vector<HashedItem>& hashed_items,
+                                     const vector<LabelKey>& label_keys) {
+        QuerySliceResult result;
+        auto slice_start = chrono::high_resolution_clock::now();
+        
+        Receiver receiver_obj(params);
+        auto query_result = receiver_obj.create_query(hashed_items);
+        
+        // 估算PSI查询密文数量（基于典型的密文使用模式）
+        uint32_t max_items_per_bin = 80; // 使用JSON中定义的值
+        result.ciphertext_count = 3 * ((hashed_items.size() + max_items_per_bin - 1) / max_items_per_bin);
+        
+        channel.send(std::move(query_result.first));
+        result.sender_time_ms = serve_sender(channel);
+        
+        auto query_response = channel.receive_response();
+        auto query_resp = to_query_response(query_response);
+        result.package_count = query_resp->package_count;
+        
+        vector<ResultPart> result_parts;
+        result_parts.reserve(query_resp->package_count);
+        for (uint32_t i = 0; i < query_resp->package_count; i++) {
+            result_parts.push_back(channel.receive_result(receiver_obj.get_seal_context()));
+        }
+        
+        auto matches = receiver_obj.process_result(label_keys, query_result.second, result_parts);
+        result.found.resize(matches.size());
+        for (size_t i = 0; i < matches.size(); i++) {
+            result.found[i] = matches[i].found;
+        }
+        
+        auto slice_end = chrono::high_resolution_clock::now();
+        result.latency_ms = chrono::duration_cast<chrono::microseconds>(slice_end - slice_start).count() / 1000.0;
+        return result;
+    }
+
+    // PSI查询阶段：按cuckoo表容量切片，最多max_concurrent个切片同时进行，结果按切片顺序合并
+    using RunSliceFn = function<QuerySliceResult(const vector<HashedItem>&, const vector<LabelKey>&)>;
+    vector<bool> run_sliced_queries(const PSIParams& params,
+                                    const pair<vector<HashedItem>, vector<LabelKey>>& receiver_oprf_items,
+                                    size_t max_concurrent,
+                                    const RunSliceFn& run_slice,
+                                    CommunicationStatsHelper& comm_helper) {
+        PrecisionTimer query_timer("PSI Query Phase");
+        
+        size_t item_count = receiver_oprf_items.first.size();
+        size_t slice_size = query_slice_size(params);
+        size_t slice_count = (item_count + slice_size - 1) / slice_size;
+        size_t worker_count = min(slice_count, max<size_t>(1, max_concurrent));
+        cout << "Splitting " << item_count << " items into " << slice_count 
+             << " query slices of up to " << slice_size << " items (" << worker_count 
+             << " concurrent)" << endl;
+        
+        vector<QuerySliceResult> slice_results(slice_count);
+        vector<exception_ptr> slice_errors(slice_count);
+        atomic<size_t> next_slice{0};
+        
+        auto worker = [&]() {
+            for (size_t k = next_slice++; k < slice_count; k = next_slice++) {
+                size_t begin = k * slice_size;
+                size_t end = min(begin + slice_size, item_count);
+                try {
+                    slice_results[k] = run_slice(
+                        vector<HashedItem>(receiver_oprf_items.first.begin() + begin, 
+                                           receiver_oprf_items.first.begin() + end),
+                        vector<LabelKey>(receiver_oprf_items.second.begin() + begin, 
+                                         receiver_oprf_items.second.begin() + end));
+                } catch (...) {
+                    slice_errors[k] = current_exception();
+                }
+            }
+        };
+        
+        vector<thread> workers;
+        for (size_t w = 1; w < worker_count; w++) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto& t : workers) {
+            t.join();
+        }
+        for (const auto& error : slice_errors) {
+            if (error) rethrow_exception(error);
+        }
+        query_timer.checkpoint("All query slices completed");
+        
+        vector<bool> found;
+        found.reserve(item_count);
+        double max_slice_latency = 0.0;
+        online_stats_.psi_processing_time = 0.0;
+        for (const auto& result : slice_results) {
+            comm_helper.record_psi_query(result.ciphertext_count);
+            comm_helper.record_psi_response(result.package_count);
+            online_stats_.psi_processing_time += result.sender_time_ms;
+            max_slice_latency = max(max_slice_latency, result.latency_ms);
+            found.insert(found.end(), result.found.begin(), result.found.end());
+        }
+        
+        cout << "PSI query phase completed successfully" << endl;
+        cout << "Max slice latency: " << max_slice_latency << " ms" << endl;
+        return found;
+    }
+
+    // 创建并填充SenderDB
+    shared_ptr<SenderDB> build_sender_db(const PSIParams& params, const vector<string>& sender_prefixes) {
+        if (options_.oprf_key_file.empty()) {
+            return build_sender_db(params, sender_prefixes, oprf::OPRFKey());
+        }
+        return build_sender_db(params, sender_prefixes, load_or_create_oprf_key());
+    }
+
+    shared_ptr<SenderDB> build_sender_db(const PSIParams& params, const vector<string>& sender_prefixes,
+                                         const oprf::OPRFKey& oprf_key) {
+        PrecisionTimer timer("Sender Database Creation");
+        
+        auto sender_db = make_shared<SenderDB>(params, oprf_key);
+        timer.checkpoint("SenderDB object created");
+        
+        vector<Item> sender_items = create_items_batch(sender_prefixes);
+        timer.checkpoint("Sender items created");
+        
+        sender_db->insert_or_assign(sender_items);
+        timer.checkpoint("Sender database populated");
+        return sender_db;
+    }
+
+    // 生成并验证参数，失败返回nullptr
+    unique_ptr<PSIParams> create_params(size_t sender_size, size_t receiver_size) {
+        PrecisionTimer timer("Parameter Setup");
+        string params_str = generate_valid_seal_params(sender_size, receiver_size);
+        timer.checkpoint("Parameter generation completed");
+        
+        auto params = make_unique<PSIParams>(PSIParams::Load(params_str));
+        timer.checkpoint("Parameter loading completed");
+        
+        if (!validate_seal_params(*params)) {
+            cout << "Parameter validation failed!" << endl;
+            return nullptr;
+        }
+        timer.checkpoint("Parameter validation completed");
+        return params;
+    }
+
     // 执行APSI协议的辅助函数
     vector<string> execute_apsi_protocol(const PSIParams& params,
                                         const vector<string>& sender_prefixes,
@@ -401,19 +1413,7 @@ private:
             StreamChannel channel(channel_stream);
 
             // 创建Sender数据库
-            shared_ptr<SenderDB> sender_db;
-            vector<Item> sender_items;
-            {
-                PrecisionTimer timer("Sender Database Creation");
-                sender_db = make_shared<SenderDB>(params);
-                timer.checkpoint("SenderDB object created");
-                
-                sender_items = create_items_batch(sender_prefixes);
-                timer.checkpoint("Sender items created");
-                
-                sender_db->insert_or_assign(sender_items);
-                timer.checkpoint("Sender database populated");
-            }
+            shared_ptr<SenderDB> sender_db = build_sender_db(params, sender_prefixes);
 
             // 准备Receiver数据
             vector<Item> receiver_items;
@@ -422,153 +1422,39 @@ private:
                 receiver_items = create_items_batch(receiver_prefixes);
             }
             
-            // 完整的APSI协议执行
-            auto start_protocol = chrono::high_resolution_clock::now();
-            
-            // OPRF阶段
-            {
-                PrecisionTimer timer("OPRF Phase");
-                
-                auto oprf_receiver = Receiver::CreateOPRFReceiver(receiver_items);
-                timer.checkpoint("OPRF receiver created");
-                
-                auto oprf_request = Receiver::CreateOPRFRequest(oprf_receiver);
-                timer.checkpoint("OPRF request created");
-                
-                // 记录OPRF请求通信量
-                comm_helper.record_oprf_request();
-                
-                // 发送OPRF请求
-                channel.send(std::move(oprf_request));
-                timer.checkpoint("OPRF request sent");
-                
-                // === SENDER在线时间开始 ===
-                auto sender_online_start = chrono::high_resolution_clock::now();
-                
-                // 接收并处理OPRF请求
-                auto received_request = channel.receive_operation(sender_db->get_seal_context());
-                timer.checkpoint("OPRF request received by sender");
-                
-                auto received_oprf_request = to_oprf_request(std::move(received_request));
-                timer.checkpoint("OPRF request converted");
-                
-                // Sender运行OPRF
+            // OPRF阶段：Sender在同一通道上直接处理请求
+            ServeSenderFn serve_oprf = [&](Channel& chl) {
+                auto received_request = chl.receive_operation(sender_db->get_seal_context());
                 auto oprf_process_start = chrono::high_resolution_clock::now();
-                Sender::RunOPRF(received_oprf_request, sender_db->get_oprf_key(), channel);
+                Sender::RunOPRF(to_oprf_request(std::move(received_request)), sender_db->get_oprf_key(), chl);
                 auto oprf_process_end = chrono::high_resolution_clock::now();
-                
-                online_stats_.oprf_processing_time = 
-                    chrono::duration_cast<chrono::microseconds>(oprf_process_end - oprf_process_start).count() / 1000.0;
-                
-                timer.checkpoint("OPRF computation completed");
-                
-                // 记录OPRF响应通信量
-                comm_helper.record_oprf_response();
-                
-                // 接收OPRF响应
-                auto response = channel.receive_response();
-                timer.checkpoint("OPRF response received");
-                
-                auto oprf_response = to_oprf_response(response);
-                timer.checkpoint("OPRF response converted");
-                
-                // 提取哈希值
-                auto receiver_oprf_items = Receiver::ExtractHashes(oprf_response, oprf_receiver);
-                timer.checkpoint("OPRF hashes extracted");
-                
-                cout << "OPRF phase completed successfully" << endl;
-                
-                // PSI查询阶段
-                {
-                    PrecisionTimer query_timer("PSI Query Phase");
-                    
-                    Receiver receiver_obj(params);
-                    query_timer.checkpoint("Receiver object created");
-                    
-                    // 创建查询
-                    auto query_result = receiver_obj.create_query(receiver_oprf_items.first);
-                    query_timer.checkpoint("Query created");
-                    
-                    // 估算PSI查询密文数量（基于典型的密文使用模式）
-                    // 修复：使用固定的max_items_per_bin值，而不是调用可能不存在的方法
-                    uint32_t max_items_per_bin = 80; // 使用JSON中定义的值
-                    size_t estimated_ciphertexts = (receiver_items.size() + max_items_per_bin - 1) 
-                                                 / max_items_per_bin;
-                    estimated_ciphertexts *= 3; // 考虑windowing参数
-                    comm_helper.record_psi_query(estimated_ciphertexts);
-                    
-                    // 发送查询
-                    channel.send(std::move(query_result.first));
-                    query_timer.checkpoint("Query sent");
-                    
-                    // === SENDER PSI处理开始 ===
-                    auto psi_process_start = chrono::high_resolution_clock::now();
-                    
-                    // 接收并处理查询
-                    auto received_query_request = channel.receive_operation(sender_db->get_seal_context());
-                    query_timer.checkpoint("Query received by sender");
-                    
-                    // 创建Query对象
-                    Query query(to_query_request(std::move(received_query_request)), sender_db);
-                    query_timer.checkpoint("Query object created");
-                    
-                    // Sender运行查询
-                    Sender::RunQuery(query, channel);
-                    
-                    auto psi_process_end = chrono::high_resolution_clock::now();
-                    online_stats_.psi_processing_time = 
-                        chrono::duration_cast<chrono::microseconds>(psi_process_end - psi_process_start).count() / 1000.0;
-                    
-                    query_timer.checkpoint("Query processing completed");
-                    
-                    cout << "PSI query phase completed successfully" << endl;
-                    
-                    // 处理结果
-                    {
-                        PrecisionTimer result_timer("Result Processing");
-                        
-                        auto query_response = channel.receive_response();
-                        result_timer.checkpoint("Query response received");
-                        
-                        auto query_resp = to_query_response(query_response);
-                        result_timer.checkpoint("Query response converted");
-                        
-                        // 记录PSI响应通信量
-                        comm_helper.record_psi_response(query_resp->package_count);
-                        
-                        cout << "Processing " << query_resp->package_count << " result packages" << endl;
-                        
-                        vector<ResultPart> result_parts;
-                        result_parts.reserve(query_resp->package_count);
-                        
-                        for (uint32_t i = 0; i < query_resp->package_count; i++) {
-                            result_parts.push_back(channel.receive_result(receiver_obj.get_seal_context()));
-                            if ((i + 1) % 100 == 0) {
-                                result_timer.checkpoint("Processed " + to_string(i + 1) + " result packages");
-                            }
-                        }
-                        result_timer.checkpoint("All result packages received");
-                        
-                        // 处理最终结果
-                        auto results = receiver_obj.process_result(
-                            receiver_oprf_items.second, 
-                            query_result.second, 
-                            result_parts
-                        );
-                        result_timer.checkpoint("Results processed");
-                        
-                        // 提取交集
-                        for (size_t i = 0; i < receiver_prefixes.size() && i < results.size(); i++) {
-                            if (results[i].found) {
-                                intersection_prefixes.push_back(receiver_prefixes[i]);
-                            }
-                        }
-                        result_timer.checkpoint("Intersection extracted");
-                        
-                        cout << "Found " << intersection_prefixes.size() << " matching prefixes" << endl;
-                    }
+                return chrono::duration_cast<chrono::microseconds>(oprf_process_end - oprf_process_start).count() / 1000.0;
+            };
+            auto receiver_oprf_items = compute_receiver_oprf(receiver_items, channel, serve_oprf, comm_helper);
+            
+            // PSI查询阶段：每个切片使用独立通道，与其他切片并发访问同一个SenderDB
+            ServeSenderFn serve_query = [&](Channel& chl) {
+                auto psi_process_start = chrono::high_resolution_clock::now();
+                auto received_query_request = chl.receive_operation(sender_db->get_seal_context());
+                Query query(to_query_request(std::move(received_query_request)), sender_db);
+                Sender::RunQuery(query, chl);
+                auto psi_process_end = chrono::high_resolution_clock::now();
+                return chrono::duration_cast<chrono::microseconds>(psi_process_end - psi_process_start).count() / 1000.0;
+            };
+            RunSliceFn run_slice = [&](const vector<HashedItem>& hashed_items, const vector<LabelKey>& label_keys) {
+                stringstream slice_stream;
+                StreamChannel slice_channel(slice_stream);
+                return run_query_slice(params, slice_channel, serve_query, hashed_items, label_keys);
+            };
+            auto found = run_sliced_queries(params, receiver_oprf_items, options_.max_concurrent_queries,
+                                            run_slice, comm_helper);
+            
+            for (size_t i = 0; i < receiver_prefixes.size() && i < found.size(); i++) {
+                if (found[i]) {
+                    intersection_prefixes.push_back(receiver_prefixes[i]);
                 }
             }
+            cout << "Found " << intersection_prefixes.size() << " matching prefixes" << endl;
             
         } catch (const exception& e) {
             cerr << "APSI protocol execution failed: " << e.what() << endl;
@@ -578,6 +1464,12 @@ private:
     }
 
 public:
+    explicit APSIDistancePSI(const RunOptions& options) : options_(options) {
+        if (!options_.oprf_cache_file.empty()) {
+            oprf_cache_ = make_unique<OPRFResultCache>(options_.oprf_cache_file);
+        }
+    }
+
     // 运行APSI交集
     vector<string> run_apsi_intersection(const vector<string>& receiver_prefixes,
                                         const vector<string>& sender_prefixes) {
@@ -588,30 +1480,19 @@ public:
             // 设置APSI环境
             {
                 PrecisionTimer timer("APSI Environment Setup");
-                ThreadPoolMgr::SetThreadCount(16); // 增加线程数
+                ThreadPoolMgr::SetThreadCount(resolve_thread_count(options_));
                 Log::SetLogLevel(Log::Level::warning); // 减少日志输出
                 timer.checkpoint("Thread pool and logging setup");
             }
 
             // 生成和验证参数
-            string params_str;
-            {
-                PrecisionTimer timer("Parameter Setup");
-                params_str = generate_valid_seal_params(sender_prefixes.size(), receiver_prefixes.size());
-                timer.checkpoint("Parameter generation completed");
-                
-                auto params = PSIParams::Load(params_str);
-                timer.checkpoint("Parameter loading completed");
-                
-                if (!validate_seal_params(params)) {
-                    cout << "Parameter validation failed!" << endl;
-                    return {};
-                }
-                timer.checkpoint("Parameter validation completed");
-                
-                // 执行完整的APSI协议
-                return execute_apsi_protocol(params, sender_prefixes, receiver_prefixes);
+            auto params = create_params(sender_prefixes.size(), receiver_prefixes.size());
+            if (!params) {
+                return {};
             }
+            
+            // 执行完整的APSI协议
+            return execute_apsi_protocol(*params, sender_prefixes, receiver_prefixes);
         } catch (const exception& e) {
             cerr << "APSI failed: " << e.what() << endl;
         }
@@ -633,8 +1514,8 @@ public:
         {
             PrecisionTimer timer("Data Loading");
             
-            receiver_prefixes = read_prefix_file("data/receiver_items.txt");
-            sender_prefixes = read_prefix_file("data/sender_items.txt");
+            receiver_prefixes = read_prefix_file(options_.receiver_items_file);
+            sender_prefixes = read_prefix_file(options_.sender_items_file);
             timer.checkpoint("Prefix files loaded");
             
             if (receiver_prefixes.empty() || sender_prefixes.empty()) {
@@ -702,6 +1583,305 @@ public:
         // 保存详细统计到文件
         save_detailed_stats(receiver_prefixes.size(), sender_prefixes.size(), intersection_prefixes.size());
     }
+
+    // 常驻Sender服务：参数和SenderDB只构建一次，之后持续响应receiver连接
+    void run_sender_service() {
+        ThreadPoolMgr::SetThreadCount(resolve_thread_count(options_));
+        
+        vector<string> sender_prefixes = read_prefix_file(options_.sender_items_file);
+        if (sender_prefixes.empty()) {
+            cerr << "Error: Failed to read " << options_.sender_items_file << endl;
+            return;
+        }
+        
+        // 参数按Sender规模选定并在服务生命周期内保持不变，receiver通过参数请求获取
+        auto params = create_params(sender_prefixes.size(), sender_prefixes.size());
+        if (!params) {
+            return;
+        }
+        shared_ptr<SenderDB> sender_db = build_sender_db(*params, sender_prefixes);
+        
+        // SIGHUP/SIGUSR1时重新读取Sender数据文件，用服务给出的密钥构建新的SenderDB；
+        // 只有显式轮换时才覆盖密钥文件，--rotate-oprf-key只作用于启动时
+        const PSIParams& service_params = *params;
+        SenderService service(options_.serve_socket, options_.service_workers, sender_db, 
+            [this, &service_params](const oprf::OPRFKey& key, bool rotated) -> shared_ptr<SenderDB> {
+                vector<string> prefixes = read_prefix_file(options_.sender_items_file);
+                if (prefixes.empty()) return nullptr;
+                auto new_db = build_sender_db(service_params, prefixes, key);
+                if (rotated && !options_.oprf_key_file.empty()) {
+                    ofstream key_out(options_.oprf_key_file, ios::binary | ios::trunc);
+                    key.save(key_out);
+                    cout << "Saved rotated sender OPRF key to " << options_.oprf_key_file << endl;
+                }
+                return new_db;
+            });
+        service.run();
+    }
+
+    // Receiver客户端：连接常驻Sender服务完成OPRF和查询
+    // 每个查询切片使用独立连接，使服务端可以并发处理
+    void run_remote_receiver() {
+        PrecisionTimer total_timer("Remote Receiver");
+        system("mkdir -p results");
+        
+        vector<string> receiver_prefixes = read_prefix_file(options_.receiver_items_file);
+        if (receiver_prefixes.empty()) {
+            cerr << "Error: Failed to read " << options_.receiver_items_file << endl;
+            return;
+        }
+        
+        int fd = connect_unix_socket(options_.connect_socket);
+        if (fd < 0) {
+            cerr << "Error: cannot connect to " << options_.connect_socket << ": " << strerror(errno) << endl;
+            return;
+        }
+        
+        vector<string> intersection_prefixes;
+        try {
+            FdStreamBuf buf(fd);
+            iostream stream(&buf);
+            StreamChannel channel(stream);
+            ServeSenderFn flush_to_service = [&stream](Channel&) {
+                stream.flush();
+                return 0.0;
+            };
+            
+            // 从服务获取参数
+            unique_ptr<PSIParams> params;
+            {
+                PrecisionTimer timer("Parameter Request");
+                channel.send(Receiver::CreateParamsRequest());
+                stream.flush();
+                auto response = channel.receive_response();
+                params = std::move(to_params_response(response)->params);
+            }
+            
+            CommunicationStatsHelper comm_helper(&comm_stats_, receiver_prefixes.size(), 
+                                                params->seal_params().poly_modulus_degree());
+            vector<Item> receiver_items = create_items_batch(receiver_prefixes);
+            auto receiver_oprf_items = compute_receiver_oprf(receiver_items, channel, flush_to_service, comm_helper);
+            
+            RunSliceFn run_slice = [&](const vector<HashedItem>& hashed_items, const vector<LabelKey>& label_keys) {
+                int slice_fd = connect_unix_socket(options_.connect_socket);
+                if (slice_fd < 0) {
+                    throw runtime_error("cannot connect to " + options_.connect_socket);
+                }
+                FdStreamBuf slice_buf(slice_fd);
+                iostream slice_stream(&slice_buf);
+                StreamChannel slice_channel(slice_stream);
+                ServeSenderFn flush_slice = [&slice_stream](Channel&) {
+                    slice_stream.flush();
+                    return 0.0;
+                };
+                auto result = run_query_slice(*params, slice_channel, flush_slice, hashed_items, label_keys);
+                close(slice_fd);
+                return result;
+            };
+            auto found = run_sliced_queries(*params, receiver_oprf_items, options_.max_concurrent_queries,
+                                            run_slice, comm_helper);
+            
+            for (size_t i = 0; i < receiver_prefixes.size() && i < found.size(); i++) {
+                if (found[i]) {
+                    intersection_prefixes.push_back(receiver_prefixes[i]);
+                }
+            }
+        } catch (const exception& e) {
+            cerr << "Remote query failed: " << e.what() << endl;
+        }
+        close(fd);
+        
+        ofstream prefix_file("results/intersection_prefixes.txt");
+        for (size_t i = 0; i < intersection_prefixes.size(); i++) {
+            prefix_file << (i + 1) << ". " << intersection_prefixes[i] << "\n";
+        }
+        
+        cout << "\n=== FINAL RESULTS ===" << endl;
+        cout << "Intersection prefixes: " << intersection_prefixes.size() << endl;
+        comm_stats_.print_summary();
+        cout << "Sender processing times are reported by the service (results/sender_service_metrics.txt)" << endl;
+    }
+
+    // 线程扩展性基准：在 1,2,4,...,N 线程下重复SenderDB构建和查询处理，
+    // 报告相对单线程的加速比和并行效率，结果写入 results/thread_scaling.csv
+    void run_scaling_benchmark() {
+        PrecisionTimer total_timer("Thread Scaling Benchmark");
+        system("mkdir -p results");
+        
+        vector<string> receiver_prefixes = read_prefix_file(options_.receiver_items_file);
+        vector<string> sender_prefixes = read_prefix_file(options_.sender_items_file);
+        if (receiver_prefixes.empty() || sender_prefixes.empty()) {
+            cerr << "Error: Failed to read prefix files" << endl;
+            return;
+        }
+        
+        auto params = create_params(sender_prefixes.size(), receiver_prefixes.size());
+        if (!params) {
+            return;
+        }
+        vector<Item> sender_items = create_items_batch(sender_prefixes);
+        vector<Item> receiver_items = create_items_batch(receiver_prefixes);
+        
+        // 所有线程数使用同一个OPRF密钥，receiver的OPRF只需计算一次
+        oprf::OPRFKey oprf_key;
+        CommunicationStats bench_comm;
+        CommunicationStatsHelper comm_helper(&bench_comm, receiver_items.size(), 
+                                            params->seal_params().poly_modulus_degree());
+        pair<vector<HashedItem>, vector<LabelKey>> receiver_oprf_items;
+        {
+            stringstream channel_stream;
+            StreamChannel channel(channel_stream);
+            ServeSenderFn serve_oprf = [&](Channel& chl) {
+                auto request = chl.receive_operation(nullptr, SenderOperationType::sop_oprf);
+                Sender::RunOPRF(to_oprf_request(std::move(request)), oprf_key, chl);
+                return 0.0;
+            };
+            receiver_oprf_items = run_oprf_round_trip(channel, serve_oprf, receiver_items);
+        }
+        
+        size_t max_threads = resolve_thread_count(options_);
+        vector<size_t> thread_counts;
+        for (size_t t = 1; t < max_threads; t *= 2) {
+            thread_counts.push_back(t);
+        }
+        thread_counts.push_back(max_threads);
+        
+        struct ScalingSample {
+            size_t threads;
+            double db_build_ms;
+            double query_ms;        // Sender处理查询的时间
+        };
+        vector<ScalingSample> samples;
+        
+        for (size_t threads : thread_counts) {
+            cout << "\n--- " << threads << " threads ---" << endl;
+            ThreadPoolMgr::SetThreadCount(threads);
+            
+            auto build_start = chrono::high_resolution_clock::now();
+            auto sender_db = make_shared<SenderDB>(*params, oprf_key);
+            sender_db->insert_or_assign(sender_items);
+            auto build_end = chrono::high_resolution_clock::now();
+            
+            // 单个切片串行执行，只测量APSI线程池内部的并行度
+            ServeSenderFn serve_query = [&](Channel& chl) {
+                auto psi_process_start = chrono::high_resolution_clock::now();
+                auto received_query_request = chl.receive_operation(sender_db->get_seal_context());
+                Query query(to_query_request(std::move(received_query_request)), sender_db);
+                Sender::RunQuery(query, chl);
+                auto psi_process_end = chrono::high_resolution_clock::now();
+                return chrono::duration_cast<chrono::microseconds>(psi_process_end - psi_process_start).count() / 1000.0;
+            };
+            RunSliceFn run_slice = [&](const vector<HashedItem>& hashed_items, const vector<LabelKey>& label_keys) {
+                stringstream slice_stream;
+                StreamChannel slice_channel(slice_stream);
+                return run_query_slice(*params, slice_channel, serve_query, hashed_items, label_keys);
+            };
+            run_sliced_queries(*params, receiver_oprf_items, 1, run_slice, comm_helper);
+            
+            samples.push_back({threads,
+                               chrono::duration_cast<chrono::microseconds>(build_end - build_start).count() / 1000.0,
+                               online_stats_.psi_processing_time});
+        }
+        
+        ofstream csv("results/thread_scaling.csv");
+        csv << "threads,db_build_ms,db_speedup,db_efficiency,query_ms,query_speedup,query_efficiency\n";
+        cout << "\n=== THREAD SCALING ===" << endl;
+        cout << setw(8) << "threads" << setw(14) << "build ms" << setw(10) << "speedup" << setw(8) << "eff"
+             << setw(14) << "query ms" << setw(10) << "speedup" << setw(8) << "eff" << endl;
+        const ScalingSample& base = samples.front();
+        for (const auto& sample : samples) {
+            double db_speedup = base.db_build_ms / sample.db_build_ms;
+            double query_speedup = base.query_ms / sample.query_ms;
+            double db_efficiency = db_speedup / sample.threads;
+            double query_efficiency = query_speedup / sample.threads;
+            csv << sample.threads << "," << sample.db_build_ms << "," << db_speedup << "," << db_efficiency << ","
+                << sample.query_ms << "," << query_speedup << "," << query_efficiency << "\n";
+            cout << fixed << setprecision(2)
+                 << setw(8) << sample.threads << setw(14) << sample.db_build_ms << setw(10) << db_speedup 
+                 << setw(8) << db_efficiency << setw(14) << sample.query_ms << setw(10) << query_speedup 
+                 << setw(8) << query_efficiency << endl;
+        }
+        cout << "Scaling results saved to results/thread_scaling.csv" << endl;
+    }
+
+    // 多档位流水线：一个SenderDB容纳所有δ档位，一次查询得到每个receiver IP的最小匹配δ
+    void run_multi_threshold_pipeline() {
+        PrecisionTimer total_timer("Multi-Threshold Pipeline");
+        
+        system("mkdir -p results");
+
+        vector<string> receiver_items, sender_items;
+        unordered_map<string, vector<uint32_t>> receiver_mapping;
+        {
+            PrecisionTimer timer("Data Loading");
+            
+            receiver_items = read_prefix_file("data/receiver_items_multi.txt");
+            sender_items = read_prefix_file("data/sender_items_multi.txt");
+            timer.checkpoint("Tagged prefix files loaded");
+            
+            if (receiver_items.empty() || sender_items.empty()) {
+                cerr << "Error: Failed to read multi-tier prefix files" << endl;
+                return;
+            }
+            
+            receiver_mapping = read_multi_mapping_file("data/receiver_prefix_to_ip_multi.txt");
+            timer.checkpoint("Mapping file loaded");
+        }
+
+        vector<string> intersection_items;
+        {
+            PrecisionTimer timer("APSI Execution");
+            intersection_items = run_apsi_intersection(receiver_items, sender_items);
+        }
+
+        {
+            PrecisionTimer timer("Tier Resolution");
+            
+            // 每个receiver IP取所有命中条目中的最小δ
+            unordered_map<uint32_t, int> min_delta;
+            for (const auto& item : intersection_items) {
+                int delta = parse_tier_delta(item);
+                auto it = receiver_mapping.find(item);
+                if (delta < 0 || it == receiver_mapping.end()) continue;
+                for (uint32_t ip : it->second) {
+                    auto [entry, inserted] = min_delta.emplace(ip, delta);
+                    if (!inserted && delta < entry->second) entry->second = delta;
+                }
+            }
+            timer.checkpoint("Minimum delta per receiver IP resolved");
+            
+            map<int, size_t> ips_per_tier;
+            for (const auto& entry : min_delta) {
+                ips_per_tier[entry.second]++;
+            }
+            
+            vector<pair<uint32_t, int>> sorted_matches(min_delta.begin(), min_delta.end());
+            sort(sorted_matches.begin(), sorted_matches.end());
+            
+            ofstream match_file("results/multi_threshold_matches.txt");
+            match_file << "# receiver IP -> smallest matching delta\n";
+            for (const auto& match : sorted_matches) {
+                match_file << match.first << " -> " << match.second << "\n";
+            }
+            match_file.close();
+            timer.checkpoint("Tier results saved");
+            
+            cout << "\n=== MULTI-THRESHOLD RESULTS ===" << endl;
+            cout << "Intersection items: " << intersection_items.size() << endl;
+            cout << "Receiver IPs matched: " << min_delta.size() << endl;
+            size_t cumulative = 0;
+            for (const auto& tier : ips_per_tier) {
+                cumulative += tier.second;
+                cout << "  delta = " << tier.first << ": " << tier.second 
+                     << " IPs (" << cumulative << " within delta <= " << tier.first << ")" << endl;
+            }
+        }
+        
+        comm_stats_.print_summary();
+        online_stats_.print_summary();
+        
+        save_detailed_stats(receiver_items.size(), sender_items.size(), intersection_items.size());
+    }
     
 private:
     void save_detailed_stats(size_t receiver_count, size_t sender_count, size_t intersection_count) {
@@ -745,12 +1925,29 @@ private:
     }
 };
 
-int main() {
+int main(int argc, char* argv[]) {
+    RunOptions options = parse_run_options(argc, argv);
+    
     cout << "Starting APSI Distance PSI with detailed timing and communication analysis..." << endl;
     
     apsi::Log::SetLogLevel(apsi::Log::Level::warning);
-    APSIDistancePSI psi_runner;
-    psi_runner.run_complete_pipeline();
+    if (!apply_cpu_topology(options)) {
+        return 1;
+    }
+    cout << "APSI thread pool: " << resolve_thread_count(options) << " threads" << endl;
+    
+    APSIDistancePSI psi_runner(options);
+    if (options.scaling_bench) {
+        psi_runner.run_scaling_benchmark();
+    } else if (!options.serve_socket.empty()) {
+        psi_runner.run_sender_service();
+    } else if (!options.connect_socket.empty()) {
+        psi_runner.run_remote_receiver();
+    } else if (options.multi_threshold) {
+        psi_runner.run_multi_threshold_pipeline();
+    } else {
+        psi_runner.run_complete_pipeline();
+    }
     
     cout << "Program completed." << endl;
     return 0;
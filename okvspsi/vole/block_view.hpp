@@ -0,0 +1,37 @@
+#pragma once
+
+// Kunlun的block (__m128i) 与 band_okvs 使用的 oc::block 之间的零拷贝视图。
+// 两者都是16字节的SSE寄存器类型，内存布局一致，BandOkvs::Encode/Decode
+// 可以直接在VOLE输出缓冲区上运行，无需逐元素转换和额外的数组。
+
+#include <emmintrin.h>
+#include <span>
+#include <type_traits>
+#include "bandokvs/band_okvs.h"
+
+static_assert(sizeof(__m128i) == sizeof(oc::block), "block and oc::block must have the same size");
+static_assert(alignof(__m128i) == alignof(oc::block), "block and oc::block must have the same alignment");
+static_assert(std::is_trivially_copyable_v<oc::block>, "oc::block must be trivially copyable");
+static_assert(std::is_standard_layout_v<oc::block>, "oc::block must be standard layout");
+
+// 将block容器（vector/span/数组）视为oc::block序列，保持const属性
+template <typename Container>
+inline auto AsOcBlocks(Container&& blocks)
+{
+    std::span view(blocks);
+    using Elem = typename decltype(view)::element_type;
+    static_assert(std::is_same_v<std::remove_const_t<Elem>, __m128i>, "AsOcBlocks expects block elements");
+    using Out = std::conditional_t<std::is_const_v<Elem>, const oc::block, oc::block>;
+    return std::span<Out>(reinterpret_cast<Out*>(view.data()), view.size());
+}
+
+// 将oc::block容器视为block序列，保持const属性
+template <typename Container>
+inline auto AsBlocks(Container&& oc_blocks)
+{
+    std::span view(oc_blocks);
+    using Elem = typename decltype(view)::element_type;
+    static_assert(std::is_same_v<std::remove_const_t<Elem>, oc::block>, "AsBlocks expects oc::block elements");
+    using Out = std::conditional_t<std::is_const_v<Elem>, const __m128i, __m128i>;
+    return std::span<Out>(reinterpret_cast<Out*>(view.data()), view.size());
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+// 协议缓冲区arena：一次性保留一整段内存（可选2MB大页），并行预先缺页，
+// 各阶段从中按64字节对齐顺序分配，阶段结束时回退到阶段开始的位置；重复运行之间Reset后复用同一段内存，
+// 不再有每次运行首次写入时的缺页风暴。容量不足时改用堆内存（计入overflow），不影响正确性。
+// 同时记录arena的峰值占用、每个阶段的峰值，以及进程的峰值RSS。
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <omp.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+static constexpr size_t ARENA_ALIGNMENT = 64;
+static constexpr size_t HUGE_PAGE_BYTES = 2 << 20;
+
+// 进程的峰值RSS（字节），Linux的ru_maxrss以KB为单位
+inline uint64_t PeakRssBytes()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return uint64_t(usage.ru_maxrss) * 1024;
+}
+
+// 进程累计的次缺页次数，两次读数之差即为期间首次写入新页的次数
+inline uint64_t MinorFaults()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return uint64_t(usage.ru_minflt);
+}
+
+class BufferArena {
+public:
+    // 分配位置，用于阶段结束时回退
+    struct Mark {
+        size_t used;
+        size_t overflow_count;
+    };
+
+    BufferArena() = default;
+    BufferArena(const BufferArena&) = delete;
+    BufferArena& operator=(const BufferArena&) = delete;
+    ~BufferArena()
+    {
+        FreeOverflow(0);
+        if (base_ != nullptr) munmap(base_, capacity_);
+    }
+
+    // 保留capacity字节。huge_pages为真时先尝试hugetlbfs大页，失败则退回普通页并建议内核使用透明大页；
+    // prefault为真时按页并行写入，提前完成缺页
+    bool Reserve(size_t capacity, bool huge_pages = false, bool prefault = true)
+    {
+        if (base_ != nullptr) return false;
+        huge_pages_ = false;
+        void* p = MAP_FAILED;
+        if (huge_pages) {
+            size_t rounded = (capacity + HUGE_PAGE_BYTES - 1) / HUGE_PAGE_BYTES * HUGE_PAGE_BYTES;
+            p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                capacity = rounded;
+                huge_pages_ = true;
+            }
+        }
+        if (p == MAP_FAILED) {
+            p = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) {
+                std::cerr << "arena mmap of " << capacity << " bytes failed" << std::endl;
+                return false;
+            }
+            if (huge_pages) madvise(p, capacity, MADV_HUGEPAGE);
+        }
+        base_ = static_cast<uint8_t*>(p);
+        capacity_ = capacity;
+        if (prefault) Prefault();
+        return true;
+    }
+
+    // 分配n个T，64字节对齐，内容未初始化
+    template <typename T>
+    T* Allocate(size_t n)
+    {
+        size_t bytes = (n * sizeof(T) + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+        if (base_ != nullptr && used_ + bytes <= capacity_) {
+            T* p = reinterpret_cast<T*>(base_ + used_);
+            used_ += bytes;
+            peak_ = std::max(peak_, used_);
+            phase_peak_ = std::max(phase_peak_, used_);
+            return p;
+        }
+        if (overflow_bytes_ == 0) {
+            std::cerr << "arena capacity " << capacity_ << " exceeded, falling back to heap" << std::endl;
+        }
+        void* p = std::aligned_alloc(ARENA_ALIGNMENT, std::max(bytes, ARENA_ALIGNMENT));
+        if (p == nullptr) throw std::bad_alloc();
+        overflow_.push_back(p);
+        overflow_bytes_ += bytes;
+        return static_cast<T*>(p);
+    }
+
+    Mark GetMark() const { return {used_, overflow_.size()}; }
+
+    // 释放mark之后的所有分配，arena内的内存保持映射和已缺页
+    void Rewind(const Mark& mark)
+    {
+        used_ = mark.used;
+        FreeOverflow(mark.overflow_count);
+    }
+
+    // 开始新一次运行：清空分配、overflow和阶段统计，保留总峰值
+    void Reset()
+    {
+        Rewind({0, 0});
+        overflow_bytes_ = 0;
+        phase_peak_ = 0;
+        phase_peaks_.clear();
+    }
+
+    // 结束一个阶段，记录该阶段内的峰值占用（同名阶段取多次中的最大值）
+    void ClosePhase(const char* name)
+    {
+        auto it = std::find_if(phase_peaks_.begin(), phase_peaks_.end(),
+                               [&](const std::pair<std::string, size_t>& p) { return p.first == name; });
+        if (it == phase_peaks_.end()) {
+            phase_peaks_.emplace_back(name, phase_peak_);
+        } else {
+            it->second = std::max(it->second, phase_peak_);
+        }
+        phase_peak_ = used_;
+    }
+
+    size_t Capacity() const { return capacity_; }
+    size_t Used() const { return used_; }
+    size_t Peak() const { return peak_; }
+    size_t OverflowBytes() const { return overflow_bytes_; }  // 本次运行中改用堆内存的字节数
+    bool UsingHugePages() const { return huge_pages_; }
+    const std::vector<std::pair<std::string, size_t>>& PhasePeaks() const { return phase_peaks_; }
+
+private:
+    void Prefault()
+    {
+        size_t page = huge_pages_ ? HUGE_PAGE_BYTES : size_t(sysconf(_SC_PAGESIZE));
+        size_t pages = (capacity_ + page - 1) / page;
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < pages; i++) {
+            base_[i * page] = 0;
+        }
+    }
+
+    void FreeOverflow(size_t keep)
+    {
+        while (overflow_.size() > keep) {
+            std::free(overflow_.back());
+            overflow_.pop_back();
+        }
+    }
+
+    uint8_t* base_ = nullptr;
+    size_t capacity_ = 0;
+    size_t used_ = 0;
+    size_t peak_ = 0;
+    size_t phase_peak_ = 0;
+    bool huge_pages_ = false;
+    std::vector<void*> overflow_;
+    size_t overflow_bytes_ = 0;
+    std::vector<std::pair<std::string, size_t>> phase_peaks_;
+};
+
+// 作用域内的分配在离开时回退
+class ArenaScope {
+public:
+    explicit ArenaScope(BufferArena* arena) : arena_(arena)
+    {
+        if (arena_ != nullptr) mark_ = arena_->GetMark();
+    }
+    ~ArenaScope()
+    {
+        if (arena_ != nullptr) arena_->Rewind(mark_);
+    }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    BufferArena* arena_;
+    BufferArena::Mark mark_{};
+};
+
+// 从arena分配n个T；arena为空时用fallback持有的堆内存
+template <typename T>
+T* ArenaOrHeap(BufferArena* arena, std::vector<T>& fallback, size_t n)
+{
+    if (arena != nullptr) return arena->Allocate<T>(n);
+    fallback.resize(n);
+    return fallback.data();
+}
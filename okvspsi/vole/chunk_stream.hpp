@@ -0,0 +1,118 @@
+#pragma once
+
+// 分块流水线传输：一个后台线程负责收发，主线程按块计算，使传输与计算重叠。
+// TCP是字节流，分块方式只影响本地的调度，收发双方各自选择块大小即可，不改变消息格式。
+
+#include "../mpc/vole/vole.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// 已完成的条目数，供主线程与收发线程之间交接
+class ChunkProgress {
+public:
+    void Publish(size_t done)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = done;
+        }
+        cv_.notify_all();
+    }
+
+    void WaitFor(size_t done)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [&]() { return done_ >= done; });
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t done_ = 0;
+};
+
+// 接收n个各item_bytes字节的条目到data，每到达一块就调用 on_chunk(begin, len)
+// chunk_items为0时整体接收
+template <typename OnChunk>
+void ReceiveChunked(NetIO& io, uint8_t* data, size_t n, size_t item_bytes, size_t chunk_items, OnChunk&& on_chunk)
+{
+    if (chunk_items == 0 || chunk_items >= n) {
+        io.ReceiveBytes(data, n * item_bytes);
+        if (n > 0) on_chunk(size_t(0), n);
+        return;
+    }
+
+    ChunkProgress progress;
+    std::thread receiver([&]() {
+        for (size_t begin = 0; begin < n; begin += chunk_items) {
+            size_t len = std::min(chunk_items, n - begin);
+            io.ReceiveBytes(data + begin * item_bytes, len * item_bytes);
+            progress.Publish(begin + len);
+        }
+    });
+    for (size_t begin = 0; begin < n; begin += chunk_items) {
+        size_t len = std::min(chunk_items, n - begin);
+        progress.WaitFor(begin + len);
+        on_chunk(begin, len);
+    }
+    receiver.join();
+}
+
+// 环形接收的默认块大小（条目数）和槽位数
+static constexpr size_t RING_CHUNK_ITEMS = 1 << 15;
+static constexpr size_t RING_SLOTS = 4;
+
+// 与ReceiveChunked相同，但只使用RING_SLOTS个块的环形缓冲区ring（RING_SLOTS·chunk_items·item_bytes字节），
+// 每到达一块调用 on_chunk(begin, len, data)，data指向该块所在的槽位，回调返回后槽位即被复用。
+// 接收内存与n无关，用于条目数由对方决定、又不需要保留全部内容的消息；chunk_items必须大于0
+template <typename OnChunk>
+void ReceiveChunkedRing(NetIO& io, uint8_t* ring, size_t n, size_t item_bytes, size_t chunk_items, OnChunk&& on_chunk)
+{
+    ChunkProgress received, consumed;
+    std::thread receiver([&]() {
+        for (size_t begin = 0, k = 0; begin < n; begin += chunk_items, k++) {
+            size_t len = std::min(chunk_items, n - begin);
+            // 等待同一槽位上的前一块处理完
+            if (k >= RING_SLOTS) consumed.WaitFor(begin - (RING_SLOTS - 1) * chunk_items);
+            io.ReceiveBytes(ring + (k % RING_SLOTS) * chunk_items * item_bytes, len * item_bytes);
+            received.Publish(begin + len);
+        }
+    });
+    for (size_t begin = 0, k = 0; begin < n; begin += chunk_items, k++) {
+        size_t len = std::min(chunk_items, n - begin);
+        received.WaitFor(begin + len);
+        on_chunk(begin, len, static_cast<const uint8_t*>(ring + (k % RING_SLOTS) * chunk_items * item_bytes));
+        consumed.Publish(begin + len);
+    }
+    receiver.join();
+}
+
+// 主线程调用 produce(begin, len) 把一块写入data，后台线程随即发出，同时主线程计算下一块
+// chunk_items为0时整体计算后发送
+template <typename Produce>
+void SendChunked(NetIO& io, uint8_t* data, size_t n, size_t item_bytes, size_t chunk_items, Produce&& produce)
+{
+    if (chunk_items == 0 || chunk_items >= n) {
+        if (n > 0) produce(size_t(0), n);
+        io.SendBytes(data, n * item_bytes);
+        return;
+    }
+
+    ChunkProgress progress;
+    std::thread sender([&]() {
+        for (size_t begin = 0; begin < n; begin += chunk_items) {
+            size_t len = std::min(chunk_items, n - begin);
+            progress.WaitFor(begin + len);
+            io.SendBytes(data + begin * item_bytes, len * item_bytes);
+        }
+    });
+    for (size_t begin = 0; begin < n; begin += chunk_items) {
+        size_t len = std::min(chunk_items, n - begin);
+        produce(begin, len);
+        progress.Publish(begin + len);
+    }
+    sender.join();
+}
@@ -0,0 +1,446 @@
+#pragma once
+
+// FastPSI协议：接收方把集合编码为OKVS P，用VOLE相关性 B = C ⊕ Δ·A 把A' = A ⊕ P发给发送方，
+// 发送方解码 K = B ⊕ Δ·A' 得到 H(Decode(K, y) ⊕ Δ·y)，与接收方的 H(Decode(C, x)) 比较得到交集，
+// H为固定密钥AES的相关性鲁棒哈希。
+// VOLE相关性由VoleBackend提供，协议消息走NetIO。
+
+#include "../mpc/vole/vole.hpp"
+#include "okvs_params.hpp"
+#include "okvs_backend.hpp"
+#include "mask_table.hpp"
+#include "fastpsi_wire.hpp"
+#include "gf128_batch.hpp"
+#include "chunk_stream.hpp"
+#include "fixed_key_aes.hpp"
+#include "buffer_arena.hpp"
+#include <chrono>
+#include <vector>
+
+// VOLE相关性来源：接收方得到 (A, C)，发送方得到 (Δ, B)，满足 B = C ⊕ Δ·A
+class VoleBackend {
+public:
+    virtual ~VoleBackend() = default;
+    virtual const char* Name() const = 0;
+    virtual void Receive(uint64_t n, std::vector<block>& vec_A, std::vector<block>& vec_C) = 0;
+    virtual void Send(uint64_t n, block& delta, std::vector<block>& vec_B) = 0;
+    // inout[i] ^= Δ·in[i]，使用与该后端相关性一致的GF(2^128)乘法
+    virtual void MulXor(const block& delta, const block* in, block* inout, size_t n) const = 0;
+};
+
+// Kunlun VOLE，与协议消息共用同一个NetIO
+// fixed_delta非空时发送方每次都使用该Δ，供跨查询复用Δ·y的非平衡模式使用
+class KunlunVoleBackend : public VoleBackend {
+public:
+    KunlunVoleBackend(NetIO& io, uint64_t t, const block* fixed_delta = nullptr) 
+        : io_(io), t_(t), fixed_delta_(fixed_delta) {}
+
+    const char* Name() const override { return "kunlun"; }
+
+    void Receive(uint64_t n, std::vector<block>& vec_A, std::vector<block>& vec_C) override
+    {
+        vec_A = VOLE::VOLE_A(io_, n, vec_C, t_);
+    }
+
+    void Send(uint64_t n, block& delta, std::vector<block>& vec_B) override
+    {
+        if (fixed_delta_ != nullptr) {
+            delta = *fixed_delta_;
+        } else {
+            PRG::Seed seed = PRG::SetSeed();
+            delta = PRG::GenRandomBlocks(seed, 1)[0];
+        }
+        VOLE::VOLE_B(io_, n, vec_B, delta, t_);
+    }
+
+    void MulXor(const block& delta, const block* in, block* inout, size_t n) const override
+    {
+        gf128_mul_xor_batch(delta, in, inout, n);
+    }
+
+private:
+    NetIO& io_;
+    uint64_t t_;
+    const block* fixed_delta_;
+};
+
+// 按握手消息构造的OKVS解码器：BandOKVS走分片实现，其他结构由OkvsBackend解码
+class OkvsDecoder {
+public:
+    explicit OkvsDecoder(const FastPSIReceiverHello& hello)
+    {
+        if (hello.okvs_type == uint64_t(OkvsType::BAND)) {
+            sharded_.Init(hello.receiver_size, hello.shard_count, hello.okvssize, hello.band_length);
+        } else {
+            backend_ = MakeOkvsBackend(OkvsType(hello.okvs_type), hello.band_length);
+            backend_->Init(hello.receiver_size, hello.okvssize);
+        }
+    }
+
+    void Decode(block* keys, block* in, block* out, uint64_t n) const
+    {
+        if (backend_ != nullptr) {
+            backend_->Decode(keys, in, out, n);
+        } else {
+            sharded_.Decode(keys, in, out, n);
+        }
+    }
+
+    // 可缓存的每键行哈希block数，0表示不支持（分片BandOKVS）
+    uint64_t RowHashBlocks() const { return backend_ != nullptr ? backend_->RowHashBlocks() : 0; }
+    void HashRows(const block* keys, block* hashes, uint64_t n) const { backend_->HashRows(keys, hashes, n); }
+    void DecodeHashed(const block* hashes, block* in, block* out, uint64_t n) const
+    {
+        backend_->DecodeHashed(hashes, in, out, n);
+    }
+
+private:
+    ShardedBandOkvs sharded_;
+    std::unique_ptr<OkvsBackend> backend_;
+};
+
+// 发送方跨查询复用的预计算，用于大发送方集合对多个小接收方查询的非平衡场景。
+// Δ·y只依赖Δ和发送方集合，加盐键只依赖盐值编号；VOLE后端给出的Δ不变时直接复用。
+// 输出masks经过相关性鲁棒哈希，多次查询使用同一个Δ不会泄露masks之间的线性关系。
+// random-band和PaXoS的行哈希只依赖加盐键和结构参数，与随接收方集合变化的OKVS长度无关，
+// 缓存后各次查询的解码只剩位置归约和求值；BandOKVS库不公开键的位置，不缓存。
+struct FastPSISenderCache {
+    bool has_delta = false;
+    block delta;
+    std::vector<block> delta_items;     // Δ·y
+    bool has_salt = false;
+    uint64_t salt_seed = 0;
+    std::vector<block> salted_keys;
+    bool has_rows = false;
+    uint64_t rows_salt_seed = 0;
+    uint64_t rows_okvs_type = 0;
+    uint64_t rows_width = 0;
+    std::vector<block> row_hashes;      // 每个键RowHashBlocks()个block
+
+    // 以给定Δ计算Δ·y，乘法使用VOLE后端的域表示
+    void Precompute(const VoleBackend& vole, const std::vector<block>& elem_hashes, const block& new_delta)
+    {
+        delta = new_delta;
+        has_delta = true;
+        delta_items.assign(elem_hashes.size(), _mm_setzero_si128());
+        vole.MulXor(delta, elem_hashes.data(), delta_items.data(), elem_hashes.size());
+    }
+
+    bool Matches(const block& other) const
+    {
+        return has_delta && _mm_movemask_epi8(_mm_cmpeq_epi8(delta, other)) == 0xFFFF;
+    }
+
+    bool RowsMatch(const FastPSIReceiverHello& hello) const
+    {
+        return has_rows && rows_salt_seed == hello.salt_seed && rows_okvs_type == hello.okvs_type &&
+               rows_width == hello.band_length;
+    }
+
+    void HashRows(const OkvsDecoder& okvs, const FastPSIReceiverHello& hello, const std::vector<block>& keys)
+    {
+        row_hashes.resize(keys.size() * okvs.RowHashBlocks());
+        okvs.HashRows(keys.data(), row_hashes.data(), keys.size());
+        rows_salt_seed = hello.salt_seed;
+        rows_okvs_type = hello.okvs_type;
+        rows_width = hello.band_length;
+        has_rows = true;
+    }
+};
+
+// 各阶段耗时（毫秒），用于基准测试；协议函数的times参数为空时不记录
+struct FastPSIPhaseTimes {
+    double okvs_encode = 0;
+    double vole = 0;
+    double a_prime = 0;      // 接收方：计算并发送A'；发送方：接收A'并计算K
+    double okvs_decode = 0;
+    double masks = 0;        // 接收方：接收并解包masks；发送方：计算、打包并发送masks
+    double intersect = 0;
+};
+
+struct FastPSIPhase {
+    const char* name;
+    double FastPSIPhaseTimes::*member;
+};
+
+inline constexpr FastPSIPhase FASTPSI_PHASES[] = {
+    {"okvs_encode", &FastPSIPhaseTimes::okvs_encode},
+    {"vole", &FastPSIPhaseTimes::vole},
+    {"a_prime", &FastPSIPhaseTimes::a_prime},
+    {"okvs_decode", &FastPSIPhaseTimes::okvs_decode},
+    {"masks", &FastPSIPhaseTimes::masks},
+    {"intersect", &FastPSIPhaseTimes::intersect},
+};
+
+// 依次记录相邻两次Mark之间的耗时；arena非空时同时记录该阶段的arena峰值占用
+class PhaseClock {
+public:
+    explicit PhaseClock(FastPSIPhaseTimes* times, BufferArena* arena = nullptr) 
+        : times_(times), arena_(arena), last_(std::chrono::steady_clock::now()) {}
+
+    void Mark(double FastPSIPhaseTimes::*phase)
+    {
+        if (arena_ != nullptr) {
+            for (const FastPSIPhase& p : FASTPSI_PHASES) {
+                if (p.member == phase) arena_->ClosePhase(p.name);
+            }
+        }
+        if (times_ == nullptr) return;
+        auto now = std::chrono::steady_clock::now();
+        times_->*phase += std::chrono::duration<double, std::milli>(now - last_).count();
+        last_ = now;
+    }
+
+private:
+    FastPSIPhaseTimes* times_;
+    BufferArena* arena_;
+    std::chrono::steady_clock::time_point last_;
+};
+
+// FastPSI接收方实现
+// arena非空时协议自有的缓冲区（masks及其打包缓冲区）从arena分配，返回前回退
+inline std::vector<block> FastPsiRecv(NetIO& io, VoleBackend& vole, std::vector<block>& elem_hashes, 
+                                      const FastPSIParams& params, FastPSIPhaseTimes* times = nullptr,
+                                      BufferArena* arena = nullptr) {
+    ArenaScope arena_scope(arena);
+    PhaseClock clock(times, arena);
+    
+    // 0. 选择分片数和OKVS参数并编码，编码先于VOLE以便把最终的OKVS大小告知发送方
+    uint64_t shard_count = params.shards != 0 
+        ? params.shards : ShardedBandOkvs::AutoShardCount(elem_hashes.size(), omp_get_max_threads());
+    OkvsParams fixed_params;
+    const OkvsParams* initial_params = nullptr;
+    if (params.okvssize != 0) {
+        fixed_params = {params.okvssize, params.band_length != 0 ? params.band_length : params.max_band_length,
+                        double(params.okvssize) / elem_hashes.size() - 1.0, 0};
+        initial_params = &fixed_params;
+    }
+    OkvsEncoding encoding;
+    OkvsType okvs_type = OkvsType(params.okvs_type);
+    bool encoded;
+    if (okvs_type == OkvsType::BAND) {
+        encoded = EncodeWithRetry(elem_hashes, shard_count, params.okvs_security, params.max_band_length, 
+                                  initial_params, encoding);
+    } else {
+        // 其他结构不分片
+        shard_count = 1;
+        std::unique_ptr<OkvsBackend> backend = MakeOkvsBackend(okvs_type, 
+            params.band_length != 0 ? params.band_length : params.max_band_length);
+        encoded = backend != nullptr && 
+                  EncodeWithBackend(elem_hashes, *backend, params.okvs_security, params.okvssize, encoding);
+    }
+    if (!encoded) {
+        std::cerr << "OKVS encoding failed for all parameter sets!" << std::endl;
+        exit(1);
+    }
+    uint64_t okvssize = encoding.params.okvssize;
+    if (params.verbose) std::cout << OkvsTypeName(okvs_type) << " OKVS_size = " << okvssize << " (epsilon = " << encoding.params.epsilon 
+              << ", band_length = " << encoding.params.band_length << ", shards = " << shard_count 
+              << ", attempts = " << encoding.attempts << ")" << std::endl;
+    
+    FastPSIReceiverHello hello{elem_hashes.size(), shard_count, okvssize, 
+                               encoding.params.band_length, encoding.salt_seed, params.okvs_type};
+    io.SendBytes(&hello, sizeof(hello));
+    
+    clock.Mark(&FastPSIPhaseTimes::okvs_encode);
+    
+    // 1. 运行VOLE接收方，获取向量A和C
+    std::vector<block> vec_A;
+    std::vector<block> vec_C;
+    vole.Receive(okvssize, vec_A, vec_C);
+    
+    clock.Mark(&FastPSIPhaseTimes::vole);
+    
+    // 3. 分块原地计算A' = A ⊕ P，每块算完立即发送
+    SendChunked(io, reinterpret_cast<uint8_t*>(vec_A.data()), okvssize, sizeof(block), params.stream_chunk,
+                [&](size_t begin, size_t len) {
+        for(size_t i = begin; i < begin + len; i++) {
+            vec_A[i] = vec_A[i] ^ encoding.output[i];
+        }
+    });
+    std::vector<block>().swap(encoding.output);
+    
+    clock.Mark(&FastPSIPhaseTimes::a_prime);
+    
+    // 4. 直接在VOLE输出C上解码，得到接收方masks
+    OkvsDecoder okvs(hello);
+    std::vector<block>& okvs_keys = encoding.salt_seed == 0 ? elem_hashes : encoding.salted_keys;
+    std::vector<block> receivermasks_heap;
+    block* receivermasks = ArenaOrHeap(arena, receivermasks_heap, elem_hashes.size());
+    okvs.Decode(okvs_keys.data(), vec_C.data(), receivermasks, elem_hashes.size());
+    CorrelationRobustHash(receivermasks, receivermasks, elem_hashes.size());
+    
+    clock.Mark(&FastPSIPhaseTimes::okvs_decode);
+    
+    // 5. 接收发送方的截断masks
+    FastPSISenderHeader header;
+    io.ReceiveBytes(&header, sizeof(header));
+    if (header.mask_bytes < MIN_MASK_BYTES || header.mask_bytes > MAX_MASK_BYTES) {
+        std::cerr << "Invalid sender mask length: " << header.mask_bytes << std::endl;
+        exit(1);
+    }
+    if (header.sender_size > MAX_PEER_SET_SIZE) {
+        std::cerr << "Invalid sender set size: " << header.sender_size << std::endl;
+        exit(1);
+    }
+    TruncateMasks(receivermasks, elem_hashes.size(), header.mask_bytes);
+    
+    // 分块接收，到达一块解包一块
+    std::vector<block> intersection_elements;
+    if (header.sender_size <= elem_hashes.size()) {
+        std::vector<uint8_t> packed_masks_heap;
+        uint8_t* packed_masks = ArenaOrHeap(arena, packed_masks_heap, header.sender_size * header.mask_bytes);
+        std::vector<block> sendermasks_heap;
+        block* sendermasks = ArenaOrHeap(arena, sendermasks_heap, header.sender_size);
+        ReceiveChunked(io, packed_masks, header.sender_size, header.mask_bytes, params.stream_chunk,
+                       [&](size_t begin, size_t len) {
+            UnpackMasks(packed_masks + begin * header.mask_bytes, len, header.mask_bytes, sendermasks + begin);
+        });
+        std::vector<uint8_t>().swap(packed_masks_heap);
+        
+        clock.Mark(&FastPSIPhaseTimes::masks);
+        
+        // 6. 计算交集 - 发送方masks装入哈希表，批量探测接收方masks，命中的接收方元素即为交集
+        MaskTable sender_mask_table(sendermasks, header.sender_size);
+        for(size_t i : sender_mask_table.ProbeBatch(receivermasks, elem_hashes.size())) {
+            intersection_elements.push_back(elem_hashes[i]);
+        }
+    } else {
+        // 发送方集合更大（非平衡场景）：用接收方masks建表，打包的发送方masks收进固定大小的环形缓冲区，
+        // 每到达一块就探测；接收内存只取决于接收方集合和块大小，不保存全部发送方masks
+        MaskTable receiver_mask_table(receivermasks, elem_hashes.size());
+        std::vector<block> matched_masks;
+        bool too_many_matches = false;
+        size_t ring_chunk = std::min<size_t>(params.stream_chunk != 0 ? params.stream_chunk : RING_CHUNK_ITEMS,
+                                             header.sender_size);
+        std::vector<uint8_t> ring_heap;
+        uint8_t* ring = ArenaOrHeap(arena, ring_heap, RING_SLOTS * ring_chunk * header.mask_bytes);
+        std::vector<block> chunk_heap;
+        block* chunk = ArenaOrHeap(arena, chunk_heap, ring_chunk);
+        ReceiveChunkedRing(io, ring, header.sender_size, header.mask_bytes, ring_chunk,
+                           [&](size_t, size_t len, const uint8_t* packed) {
+            UnpackMasks(packed, len, header.mask_bytes, chunk);
+            for(size_t i : receiver_mask_table.ProbeBatch(chunk, len)) {
+                // 诚实发送方的命中数不超过接收方集合大小
+                if (matched_masks.size() == elem_hashes.size()) {
+                    too_many_matches = true;
+                    break;
+                }
+                matched_masks.push_back(chunk[i]);
+            }
+        });
+        if (too_many_matches) {
+            std::cerr << "Sender masks matched more than " << elem_hashes.size() << " receiver masks" << std::endl;
+            exit(1);
+        }
+        
+        clock.Mark(&FastPSIPhaseTimes::masks);
+        
+        // 6. 命中的masks映射回接收方元素
+        MaskTable matched_table(matched_masks.data(), matched_masks.size());
+        for(size_t i : matched_table.ProbeBatch(receivermasks, elem_hashes.size())) {
+            intersection_elements.push_back(elem_hashes[i]);
+        }
+    }
+    
+    clock.Mark(&FastPSIPhaseTimes::intersect);
+    
+    return intersection_elements;
+}
+
+// FastPSI发送方实现
+// cache非空时复用其中的Δ·y和加盐键，Δ或盐值变化时就地更新；
+// arena非空时A'、masks及其打包缓冲区从arena分配，返回前回退
+inline void FastPsiSend(NetIO& io, VoleBackend& vole, std::vector<block>& elem_hashes, const FastPSIParams& params,
+                        FastPSIPhaseTimes* times = nullptr, FastPSISenderCache* cache = nullptr,
+                        BufferArena* arena = nullptr) {
+    ArenaScope arena_scope(arena);
+    PhaseClock clock(times, arena);
+    
+    // 0. 接收接收方选定的OKVS参数
+    FastPSIReceiverHello hello;
+    io.ReceiveBytes(&hello, sizeof(hello));
+    if (hello.shard_count == 0 || hello.shard_count > hello.receiver_size + 1) {
+        std::cerr << "Invalid OKVS shard count: " << hello.shard_count << std::endl;
+        exit(1);
+    }
+    if (hello.okvs_type > uint64_t(OkvsType::PAXOS) || 
+        (hello.okvs_type != uint64_t(OkvsType::BAND) && hello.shard_count != 1)) {
+        std::cerr << "Invalid OKVS type: " << hello.okvs_type << std::endl;
+        exit(1);
+    }
+    clock.Mark(&FastPSIPhaseTimes::okvs_encode); // 发送方在等待接收方编码
+    
+    // 1. 运行VOLE发送方，获取向量B和delta
+    std::vector<block> vec_B;
+    block delta;
+    vole.Send(hello.okvssize, delta, vec_B);
+    
+    clock.Mark(&FastPSIPhaseTimes::vole);
+    
+    // 2-3. 分块接收A'，每到达一块就原地计算 k = B ⊕ (delta * A')，结果写回vec_B
+    std::vector<block> vec_A_prime_heap;
+    block* vec_A_prime = ArenaOrHeap(arena, vec_A_prime_heap, hello.okvssize);
+    ReceiveChunked(io, reinterpret_cast<uint8_t*>(vec_A_prime), hello.okvssize, sizeof(block), 
+                   params.stream_chunk, [&](size_t begin, size_t len) {
+        vole.MulXor(delta, vec_A_prime + begin, vec_B.data() + begin, len);
+    });
+    std::vector<block>().swap(vec_A_prime_heap);
+    
+    clock.Mark(&FastPSIPhaseTimes::a_prime);
+    
+    // 4. 以与接收方相同的结构和分片初始化OKVS，直接在k向量上并行解码获取发送方masks
+    OkvsDecoder okvs(hello);
+    
+    std::vector<block> local_salted_keys;
+    std::vector<block>* salted_keys = &local_salted_keys;
+    if (cache != nullptr) {
+        if (!cache->has_salt || cache->salt_seed != hello.salt_seed) {
+            cache->salted_keys = SaltKeys(elem_hashes, hello.salt_seed);
+            cache->salt_seed = hello.salt_seed;
+            cache->has_salt = true;
+        }
+        salted_keys = &cache->salted_keys;
+    } else {
+        local_salted_keys = SaltKeys(elem_hashes, hello.salt_seed);
+    }
+    std::vector<block>& okvs_keys = hello.salt_seed == 0 ? elem_hashes : *salted_keys;
+    std::vector<block> sendermasks_heap;
+    block* sendermasks = ArenaOrHeap(arena, sendermasks_heap, elem_hashes.size());
+    if (cache != nullptr && okvs.RowHashBlocks() != 0) {
+        if (!cache->RowsMatch(hello)) cache->HashRows(okvs, hello, okvs_keys);
+        okvs.DecodeHashed(cache->row_hashes.data(), vec_B.data(), sendermasks, elem_hashes.size());
+    } else {
+        okvs.Decode(okvs_keys.data(), vec_B.data(), sendermasks, elem_hashes.size());
+    }
+    
+    clock.Mark(&FastPSIPhaseTimes::okvs_decode);
+    
+    // Δ与缓存一致时直接复用Δ·y
+    if (cache != nullptr && !cache->Matches(delta)) {
+        cache->Precompute(vole, elem_hashes, delta);
+    }
+    
+    // 5-6. 分块完成最终计算 masks = H(masks ⊕ delta * y)，截断打包后立即发送给接收方
+    FastPSISenderHeader header;
+    header.sender_size = elem_hashes.size();
+    header.mask_bytes = params.mask_bytes != 0 
+        ? std::clamp<uint64_t>(params.mask_bytes, MIN_MASK_BYTES, MAX_MASK_BYTES)
+        : MaskBytesFor(elem_hashes.size(), hello.receiver_size, params.stat_security);
+    io.SendBytes(&header, sizeof(header));
+    std::vector<uint8_t> packed_masks_heap;
+    uint8_t* packed_masks = ArenaOrHeap(arena, packed_masks_heap, header.sender_size * header.mask_bytes);
+    SendChunked(io, packed_masks, header.sender_size, header.mask_bytes, params.stream_chunk,
+                [&](size_t begin, size_t len) {
+        if (cache != nullptr) {
+            for (size_t i = begin; i < begin + len; i++) {
+                sendermasks[i] = sendermasks[i] ^ cache->delta_items[i];
+            }
+        } else {
+            vole.MulXor(delta, elem_hashes.data() + begin, sendermasks + begin, len);
+        }
+        CorrelationRobustHash(sendermasks + begin, sendermasks + begin, len);
+        PackMasks(sendermasks + begin, len, header.mask_bytes, packed_masks + begin * header.mask_bytes);
+    });
+    clock.Mark(&FastPSIPhaseTimes::masks);
+}
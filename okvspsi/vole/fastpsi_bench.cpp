@@ -0,0 +1,594 @@
+#include "../mpc/vole/vole.hpp"
+#include "fastpsi.hpp"
+#include "fixed_key_aes.hpp"
+#include "hash_to_block.hpp"
+#include "parallel_vole.hpp"
+#include "partitioned_psi.hpp"
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// FastPSI基准测试：双方在同一进程的两个线程中、fork出的两个进程中，或由 --role 分别启动，
+// 经回环（或真实）TCP连接运行协议。每组参数先预热再重复若干次，输出各阶段耗时的中位数/p95
+// 以及每个方向的字节数（JSON）。
+
+struct BenchOptions {
+    uint64_t sender_size = 1 << 16;
+    uint64_t receiver_size = 1 << 16;
+    uint64_t intersection = 100;
+    double okvs_factor = 0;         // OKVS大小 = factor * 接收方集合大小，0表示自动选择
+    uint64_t band_length = 0;       // 0表示自动选择
+    OkvsType okvs = OkvsType::BAND;
+    uint64_t t = 397;
+    size_t vole_channels = 1;       // 非分桶模式下VOLE的通道数，大于1时在协议端口之后的连续端口上并行生成
+    uint64_t stream_chunk = 1 << 15;
+    vector<int> threads;            // 依次测试的线程数
+    size_t warmup = 1;
+    size_t trials = 5;
+    uint16_t port = 8090;
+    string mode = "threads";        // threads | processes
+    string role;                    // receiver | sender，分别在两个终端/主机上运行
+    string peer = "127.0.0.1";
+    string output;                  // JSON输出文件，为空时打印到标准输出
+    bool unbalanced = false;        // 发送方固定Δ并跨查询复用预计算
+    uint64_t partitions = 0;        // 分桶数，与memory_budget、lanes任一非默认时使用分桶FastPSI
+    uint64_t memory_budget = 0;     // 分桶模式的内存预算（字节）
+    size_t lanes = 1;               // 分桶模式同时运行的桶数，各占一个连续端口
+    uint64_t arena_bytes = 0;       // 每方协议缓冲区arena的容量，0表示不使用arena
+    bool huge_pages = false;        // arena使用2MB大页
+    string receiver_file;           // 每行一个字符串元素，经hash_to_block.hpp映射为block；为空时生成合成元素
+    string sender_file;
+
+    bool Partitioned() const { return partitions != 0 || memory_budget != 0 || lanes > 1; }
+    // 只给出一方的文件时（--role分别运行），本地不知道对方的集合，无法核对交集大小
+    bool IntersectionKnown() const { return receiver_file.empty() == sender_file.empty(); }
+    // 每次运行占用的端口数
+    size_t PortsPerRun() const { return Partitioned() ? lanes : 1 + (vole_channels > 1 ? vole_channels : 0); }
+};
+
+BenchOptions ParseBenchOptions(int argc, char* argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--sender-size" && i + 1 < argc) {
+            options.sender_size = stoull(argv[++i]);
+        } else if (arg == "--receiver-size" && i + 1 < argc) {
+            options.receiver_size = stoull(argv[++i]);
+        } else if (arg == "--intersection" && i + 1 < argc) {
+            options.intersection = stoull(argv[++i]);
+        } else if (arg == "--okvs-factor" && i + 1 < argc) {
+            options.okvs_factor = stod(argv[++i]);
+        } else if (arg == "--band-length" && i + 1 < argc) {
+            options.band_length = stoull(argv[++i]);
+        } else if (arg == "--okvs" && i + 1 < argc) {
+            if (!OkvsTypeFromName(argv[++i], options.okvs)) {
+                cerr << "Unknown OKVS type: " << argv[i] << endl;
+                exit(1);
+            }
+        } else if (arg == "--vole-t" && i + 1 < argc) {
+            options.t = stoull(argv[++i]);
+        } else if (arg == "--vole-channels" && i + 1 < argc) {
+            options.vole_channels = max<size_t>(1, stoul(argv[++i]));
+        } else if (arg == "--chunk" && i + 1 < argc) {
+            options.stream_chunk = stoull(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            stringstream ss(argv[++i]);
+            string item;
+            while (getline(ss, item, ',')) {
+                if (!item.empty()) options.threads.push_back(max(1, stoi(item)));
+            }
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            options.warmup = stoul(argv[++i]);
+        } else if (arg == "--trials" && i + 1 < argc) {
+            options.trials = max<size_t>(1, stoul(argv[++i]));
+        } else if (arg == "--port" && i + 1 < argc) {
+            options.port = static_cast<uint16_t>(stoul(argv[++i]));
+        } else if (arg == "--mode" && i + 1 < argc) {
+            options.mode = argv[++i];
+        } else if (arg == "--role" && i + 1 < argc) {
+            options.role = argv[++i];
+        } else if (arg == "--peer" && i + 1 < argc) {
+            options.peer = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            options.output = argv[++i];
+        } else if (arg == "--unbalanced") {
+            options.unbalanced = true;
+        } else if (arg == "--partitions" && i + 1 < argc) {
+            options.partitions = stoull(argv[++i]);
+        } else if (arg == "--memory-budget" && i + 1 < argc) {
+            options.memory_budget = stoull(argv[++i]) << 20;
+        } else if (arg == "--lanes" && i + 1 < argc) {
+            options.lanes = max<size_t>(1, stoul(argv[++i]));
+        } else if (arg == "--arena" && i + 1 < argc) {
+            options.arena_bytes = stoull(argv[++i]) << 20;
+        } else if (arg == "--huge-pages") {
+            options.huge_pages = true;
+        } else if (arg == "--receiver-file" && i + 1 < argc) {
+            options.receiver_file = argv[++i];
+        } else if (arg == "--sender-file" && i + 1 < argc) {
+            options.sender_file = argv[++i];
+        } else {
+            cerr << "Usage: " << argv[0] << " [--sender-size <n>] [--receiver-size <n>] [--intersection <n>]"
+                 << " [--okvs-factor <f>] [--band-length <w>] [--okvs band|random-band|paxos] [--vole-t <t>] [--vole-channels <n>] [--chunk <n>] [--threads <n,n,...>]"
+                 << " [--warmup <n>] [--trials <n>] [--port <p>] [--mode threads|processes]"
+                 << " [--role receiver|sender] [--peer <ip>] [--output <file>] [--unbalanced]"
+                 << " [--partitions <k>] [--memory-budget <MiB>] [--lanes <n>] [--arena <MiB>] [--huge-pages]"
+                 << " [--receiver-file <file>] [--sender-file <file>]" << endl;
+            exit(1);
+        }
+    }
+    if (options.threads.empty()) options.threads.push_back(omp_get_max_threads());
+    if (options.intersection > min(options.sender_size, options.receiver_size)) {
+        cerr << "Intersection size exceeds set size" << endl;
+        exit(1);
+    }
+    if (options.mode != "threads" && options.mode != "processes") {
+        cerr << "Unknown mode: " << options.mode << endl;
+        exit(1);
+    }
+    if (!options.role.empty() && options.role != "receiver" && options.role != "sender") {
+        cerr << "Unknown role: " << options.role << endl;
+        exit(1);
+    }
+    if (options.unbalanced && options.Partitioned()) {
+        cerr << "--unbalanced cannot be combined with partitioned mode" << endl;
+        exit(1);
+    }
+    if (options.vole_channels > 1 && options.Partitioned()) {
+        cerr << "--vole-channels cannot be combined with partitioned mode" << endl;
+        exit(1);
+    }
+    if (!options.IntersectionKnown() && options.role.empty()) {
+        cerr << "Both --receiver-file and --sender-file are required unless --role is given" << endl;
+        exit(1);
+    }
+    return options;
+}
+
+// 读取每行一个元素的文件，跳过空行并去重（保留首次出现的顺序）；重复元素会成为重复的OKVS键
+bool ReadLines(const string& filename, vector<string>& lines)
+{
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << filename << " open error" << endl;
+        return false;
+    }
+    unordered_set<string> seen;
+    size_t duplicates = 0;
+    string line;
+    while (getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        if (seen.insert(line).second) {
+            lines.push_back(line);
+        } else {
+            duplicates++;
+        }
+    }
+    if (duplicates != 0) cerr << filename << ": skipped " << duplicates << " duplicate lines" << endl;
+    return true;
+}
+
+// 从文件读取元素并映射为block，给出文件的一方集合大小取自去重后的文件；
+// 两个文件都在本地时按明文求交得到期望的交集大小。返回映射所用的时间（毫秒）
+double LoadFileItems(BenchOptions& options, vector<block>& receiver_items, vector<block>& sender_items)
+{
+    vector<string> receiver_lines, sender_lines;
+    if ((!options.receiver_file.empty() && !ReadLines(options.receiver_file, receiver_lines)) ||
+        (!options.sender_file.empty() && !ReadLines(options.sender_file, sender_lines))) {
+        exit(1);
+    }
+    auto start = chrono::steady_clock::now();
+    if (!options.receiver_file.empty()) receiver_items = HashStringsToBlocks(receiver_lines);
+    if (!options.sender_file.empty()) sender_items = HashStringsToBlocks(sender_lines);
+    double hash_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    if (!options.receiver_file.empty()) options.receiver_size = receiver_items.size();
+    if (!options.sender_file.empty()) options.sender_size = sender_items.size();
+    if (options.IntersectionKnown()) {
+        unordered_set<string> receiver_set(receiver_lines.begin(), receiver_lines.end());
+        options.intersection = 0;
+        for (const string& item : sender_lines) options.intersection += receiver_set.count(item);
+    }
+    return hash_ms;
+}
+
+// glibc的tcp_info止于tcpi_total_retrans，内核在其后追加了64位计数（Linux 4.1+），布局与此一致
+struct TcpInfoWithBytes {
+    struct tcp_info base;
+    uint64_t pacing_rate;
+    uint64_t max_pacing_rate;
+    uint64_t bytes_acked;
+    uint64_t bytes_received;
+};
+
+// NetIO不暴露套接字，按端口在本进程的描述符中找到协议连接：
+// 接收方（服务端）的本地端口为port，发送方（客户端）的对端端口为port
+uint64_t SocketBytesReceived(uint16_t port, bool server_side)
+{
+    for (int fd = 0; fd < 1024; fd++) {
+        sockaddr_in local{}, peer{};
+        socklen_t local_len = sizeof(local), peer_len = sizeof(peer);
+        if (getsockname(fd, reinterpret_cast<sockaddr*>(&local), &local_len) != 0 || local.sin_family != AF_INET) continue;
+        if (getpeername(fd, reinterpret_cast<sockaddr*>(&peer), &peer_len) != 0) continue;
+        uint16_t match = ntohs(server_side ? local.sin_port : peer.sin_port);
+        if (match != port) continue;
+        TcpInfoWithBytes info{};
+        socklen_t info_len = sizeof(info);
+        if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &info_len) != 0 || info_len < sizeof(info)) return 0;
+        return info.bytes_received;
+    }
+    return 0;
+}
+
+// 一方一次运行的结果，进程模式下经管道原样传回
+struct PartyResult {
+    FastPSIPhaseTimes phases;
+    double total_ms = 0;
+    uint64_t bytes_received = 0;
+    uint64_t intersection_size = 0;
+    uint64_t minor_faults = 0;      // 本次运行期间整个进程的次缺页数
+    uint64_t peak_rss = 0;
+    uint64_t arena_peak = 0;
+    uint64_t arena_overflow = 0;
+    uint64_t arena_phase_peak[size(FASTPSI_PHASES)] = {};
+};
+
+// 运行前重置arena并记录缺页计数，运行后填入内存统计
+class MemoryProbe {
+public:
+    explicit MemoryProbe(BufferArena* arena) : arena_(arena)
+    {
+        if (arena_ != nullptr) arena_->Reset();
+        faults_ = MinorFaults();
+    }
+
+    void Fill(PartyResult& result) const
+    {
+        result.minor_faults = MinorFaults() - faults_;
+        result.peak_rss = PeakRssBytes();
+        if (arena_ == nullptr) return;
+        result.arena_peak = arena_->Peak();
+        result.arena_overflow = arena_->OverflowBytes();
+        for (const auto& phase : arena_->PhasePeaks()) {
+            for (size_t i = 0; i < size(FASTPSI_PHASES); i++) {
+                if (phase.first == FASTPSI_PHASES[i].name) result.arena_phase_peak[i] = phase.second;
+            }
+        }
+    }
+
+private:
+    BufferArena* arena_;
+    uint64_t faults_;
+};
+
+// 分桶模式：每个通道一条连接，端口依次为 port, port+1, ...
+struct BenchLanes {
+    vector<unique_ptr<NetIO>> ios;
+    vector<unique_ptr<KunlunVoleBackend>> voles;
+    vector<PsiLane> lanes;
+
+    BenchLanes(const BenchOptions& options, const FastPSIParams& params, uint16_t port, bool server)
+    {
+        for (size_t l = 0; l < options.lanes; l++) {
+            ios.push_back(make_unique<NetIO>(server ? "server" : "client", server ? "" : options.peer, port + l));
+            voles.push_back(make_unique<KunlunVoleBackend>(*ios.back(), params.t));
+            lanes.push_back({ios.back().get(), voles.back().get()});
+        }
+    }
+
+    static uint64_t BytesReceived(const BenchOptions& options, uint16_t port, bool server_side)
+    {
+        uint64_t bytes = 0;
+        for (size_t l = 0; l < options.lanes; l++) bytes += SocketBytesReceived(port + l, server_side);
+        return bytes;
+    }
+};
+
+// 非分桶模式的VOLE后端：--vole-channels大于1时在 port+1 起的连续端口上建立VOLE专用连接
+struct BenchVole {
+    vector<unique_ptr<NetIO>> channel_ios;
+    unique_ptr<VoleBackend> vole;
+
+    BenchVole(const BenchOptions& options, const FastPSIParams& params, NetIO& io, uint16_t port, bool server,
+              const block* fixed_delta = nullptr)
+    {
+        if (options.vole_channels > 1) {
+            channel_ios = OpenVoleChannels(server ? "server" : "client", server ? "" : options.peer, port + 1,
+                                           options.vole_channels);
+            vole = make_unique<ParallelVoleBackend>(ChannelPointers(channel_ios), params.t, fixed_delta);
+        } else {
+            vole = make_unique<KunlunVoleBackend>(io, params.t, fixed_delta);
+        }
+    }
+
+    static uint64_t BytesReceived(const BenchOptions& options, uint16_t port, bool server_side)
+    {
+        uint64_t bytes = 0;
+        for (size_t p = 0; p < options.PortsPerRun(); p++) bytes += SocketBytesReceived(port + p, server_side);
+        return bytes;
+    }
+};
+
+// arena只用于非分桶模式：分桶模式的各通道并发运行，不能共享一个arena
+PartyResult RunReceiver(const BenchOptions& options, const FastPSIParams& params, vector<block>& items, uint16_t port,
+                        BufferArena* arena)
+{
+    PartyResult result;
+    if (options.Partitioned()) {
+        BenchLanes lanes(options, params, port, true);
+        PartitionParams partition_params{options.partitions, options.memory_budget};
+        auto start_time = chrono::steady_clock::now();
+        vector<block> intersection = PartitionedPsiRecv(lanes.lanes, items, params, partition_params, &result.phases);
+        result.total_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time).count();
+        result.bytes_received = BenchLanes::BytesReceived(options, port, true);
+        result.intersection_size = intersection.size();
+        return result;
+    }
+    NetIO io("server", "", port);
+    BenchVole vole(options, params, io, port, true);
+    MemoryProbe probe(arena);
+    auto start_time = chrono::steady_clock::now();
+    vector<block> intersection = FastPsiRecv(io, *vole.vole, items, params, &result.phases, arena);
+    result.total_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time).count();
+    probe.Fill(result);
+    result.bytes_received = BenchVole::BytesReceived(options, port, true);
+    result.intersection_size = intersection.size();
+    return result;
+}
+
+// 非平衡模式下cache非空：发送方固定使用cache中的Δ，Δ·y和加盐键只在第一次查询时计算
+PartyResult RunSender(const BenchOptions& options, const FastPSIParams& params, vector<block>& items, uint16_t port,
+                      FastPSISenderCache* cache, BufferArena* arena)
+{
+    PartyResult result;
+    if (options.Partitioned()) {
+        BenchLanes lanes(options, params, port, false);
+        PartitionParams partition_params{options.partitions, options.memory_budget};
+        auto start_time = chrono::steady_clock::now();
+        PartitionedPsiSend(lanes.lanes, items, params, partition_params, &result.phases);
+        result.total_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time).count();
+        result.bytes_received = BenchLanes::BytesReceived(options, port, false);
+        return result;
+    }
+    NetIO io("client", options.peer, port);
+    BenchVole vole(options, params, io, port, false, cache != nullptr ? &cache->delta : nullptr);
+    MemoryProbe probe(arena);
+    auto start_time = chrono::steady_clock::now();
+    FastPsiSend(io, *vole.vole, items, params, &result.phases, cache, arena);
+    result.total_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start_time).count();
+    probe.Fill(result);
+    result.bytes_received = BenchVole::BytesReceived(options, port, false);
+    return result;
+}
+
+// 中位数与p95（最近秩）
+struct Summary {
+    double median;
+    double p95;
+};
+
+Summary Summarize(vector<double> samples)
+{
+    sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    double median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    size_t rank = static_cast<size_t>(ceil(0.95 * n));
+    return {median, samples[max<size_t>(rank, 1) - 1]};
+}
+
+void WriteSummary(ostream& out, const string& name, const vector<double>& samples, bool last = false)
+{
+    Summary s = Summarize(samples);
+    out << "        \"" << name << "\": {\"median\": " << s.median << ", \"p95\": " << s.p95 << "}"
+        << (last ? "\n" : ",\n");
+}
+
+void WritePartyJson(ostream& out, const string& party, const vector<PartyResult>& results, bool last)
+{
+    out << "      \"" << party << "\": {\n";
+    for (const FastPSIPhase& phase : FASTPSI_PHASES) {
+        vector<double> samples;
+        for (const PartyResult& r : results) samples.push_back(r.phases.*(phase.member));
+        WriteSummary(out, string(phase.name) + "_ms", samples);
+    }
+    vector<double> faults;
+    for (const PartyResult& r : results) faults.push_back(double(r.minor_faults));
+    WriteSummary(out, "minor_faults", faults);
+    // 峰值取最后一次运行：arena峰值跨运行累积，ru_maxrss本身就是进程的历史峰值
+    const PartyResult& last_run = results.back();
+    out << "        \"peak_rss_bytes\": " << last_run.peak_rss << ",\n";
+    if (last_run.arena_peak != 0) {
+        out << "        \"arena_peak_bytes\": " << last_run.arena_peak << ",\n";
+        out << "        \"arena_overflow_bytes\": " << last_run.arena_overflow << ",\n";
+        out << "        \"arena_phase_peak_bytes\": {";
+        for (size_t i = 0; i < size(FASTPSI_PHASES); i++) {
+            out << (i ? ", " : "") << "\"" << FASTPSI_PHASES[i].name << "\": " << last_run.arena_phase_peak[i];
+        }
+        out << "},\n";
+    }
+    vector<double> totals;
+    for (const PartyResult& r : results) totals.push_back(r.total_ms);
+    WriteSummary(out, "total_ms", totals, true);
+    out << "      }" << (last ? "\n" : ",\n");
+}
+
+int main(int argc, char* argv[])
+{
+    BenchOptions options = ParseBenchOptions(argc, argv);
+    CRYPTO_Initialize();
+
+    // 接收方集合为 [0, N_r)，发送方集合的前intersection个元素与接收方重叠；指定文件时改用文件中的元素
+    vector<block> receiver_items, sender_items;
+    double input_hash_ms = 0;
+    if (!options.receiver_file.empty() || !options.sender_file.empty()) {
+        input_hash_ms = LoadFileItems(options, receiver_items, sender_items);
+    } else {
+        GeneratePartyItems(options.receiver_size, options.sender_size, options.intersection, receiver_items, sender_items);
+    }
+
+    FastPSIParams params;
+    params.t = options.t;
+    params.okvssize = static_cast<uint64_t>(options.okvs_factor * options.receiver_size);
+    params.band_length = options.band_length;
+    params.okvs_type = uint64_t(options.okvs);
+    params.stream_chunk = options.stream_chunk;
+    params.verbose = false;
+
+    // 非平衡模式：发送方选定长期使用的Δ，预热查询完成一次性预计算
+    FastPSISenderCache sender_cache;
+    FastPSISenderCache* cache = nullptr;
+    if (options.unbalanced) {
+        PRG::Seed seed = PRG::SetSeed();
+        sender_cache.delta = PRG::GenRandomBlocks(seed, 1)[0];
+        cache = &sender_cache;
+    }
+
+    bool run_receiver = options.role != "sender";
+    bool run_sender = options.role != "receiver";
+    bool use_processes = options.role.empty() && options.mode == "processes";
+
+    // 进程模式：发送方在子进程中运行，每次运行的结果写回管道
+    int result_pipe[2] = {-1, -1};
+    pid_t child = -1;
+    if (use_processes) {
+        if (pipe(result_pipe) != 0) {
+            cerr << "pipe failed" << endl;
+            return 1;
+        }
+        child = fork();
+        if (child == 0) {
+            close(result_pipe[0]);
+            run_receiver = false;
+        } else {
+            close(result_pipe[1]);
+            run_sender = false;
+        }
+    }
+
+    // 每方一个arena，在所有运行之间复用；预先缺页在计时之外完成
+    BufferArena receiver_arena, sender_arena;
+    BufferArena* receiver_arena_ptr = nullptr;
+    BufferArena* sender_arena_ptr = nullptr;
+    if (options.arena_bytes != 0 && !options.Partitioned()) {
+        if (run_receiver && receiver_arena.Reserve(options.arena_bytes, options.huge_pages)) {
+            receiver_arena_ptr = &receiver_arena;
+        }
+        if (run_sender && sender_arena.Reserve(options.arena_bytes, options.huge_pages)) {
+            sender_arena_ptr = &sender_arena;
+        }
+    }
+
+    ostringstream json;
+    json << "{\n  \"sender_size\": " << options.sender_size << ",\n  \"receiver_size\": " << options.receiver_size
+         << ",\n  \"intersection\": " << (options.IntersectionKnown() ? to_string(options.intersection) : "null")
+         << ",\n  \"okvs_factor\": " << options.okvs_factor
+         << ",\n  \"band_length\": " << options.band_length << ",\n  \"okvs\": \"" << OkvsTypeName(options.okvs)
+         << "\",\n  \"unbalanced\": " 
+         << (options.unbalanced ? "true" : "false") << ",\n  \"partitions\": " << options.partitions
+         << ",\n  \"memory_budget\": " << options.memory_budget << ",\n  \"lanes\": " << options.lanes
+         << ",\n  \"vole_channels\": " << options.vole_channels
+         << ",\n  \"input_hash_ms\": " << input_hash_ms << ",\n  \"arena_bytes\": " << options.arena_bytes << ",\n  \"huge_pages\": " 
+         << (receiver_arena.UsingHugePages() || sender_arena.UsingHugePages() ? "true" : "false")
+         << ",\n  \"mode\": \""
+         << (options.role.empty() ? options.mode : options.role) << "\",\n  \"runs\": [\n";
+
+    // 每次运行使用新端口，避免上一条连接的TIME_WAIT
+    uint16_t port = options.port;
+    bool all_correct = true;
+    for (size_t c = 0; c < options.threads.size(); c++) {
+        omp_set_num_threads(options.threads[c]);
+        vector<PartyResult> receiver_results, sender_results;
+
+        for (size_t trial = 0; trial < options.warmup + options.trials; trial++, port += options.PortsPerRun()) {
+            PartyResult receiver_result, sender_result;
+            if (run_receiver && run_sender) {
+                // OpenMP线程数是线程局部的设置，新线程不会继承主线程的omp_set_num_threads
+                thread sender_thread([&, port]() {
+                    omp_set_num_threads(options.threads[c]);
+                    sender_result = RunSender(options, params, sender_items, port, cache, sender_arena_ptr);
+                });
+                receiver_result = RunReceiver(options, params, receiver_items, port, receiver_arena_ptr);
+                sender_thread.join();
+            } else if (run_receiver) {
+                receiver_result = RunReceiver(options, params, receiver_items, port, receiver_arena_ptr);
+                if (use_processes && read(result_pipe[0], &sender_result, sizeof(sender_result)) != sizeof(sender_result)) {
+                    cerr << "sender process exited early" << endl;
+                    return 1;
+                }
+            } else {
+                // 给接收方留出监听的时间
+                this_thread::sleep_for(chrono::milliseconds(100));
+                sender_result = RunSender(options, params, sender_items, port, cache, sender_arena_ptr);
+                if (use_processes && write(result_pipe[1], &sender_result, sizeof(sender_result)) != sizeof(sender_result)) {
+                    return 1;
+                }
+            }
+
+            if (trial < options.warmup) continue;
+            if (run_receiver) {
+                if (options.IntersectionKnown()) {
+                    all_correct = all_correct && receiver_result.intersection_size == options.intersection;
+                }
+                receiver_results.push_back(receiver_result);
+            }
+            if (run_sender || use_processes) sender_results.push_back(sender_result);
+        }
+
+        if (child == 0) continue;
+
+        json << "    {\n      \"threads\": " << options.threads[c] << ",\n      \"trials\": " << options.trials << ",\n";
+        // 每个方向的字节数取自对方接收到的字节数
+        if (!receiver_results.empty()) {
+            json << "      \"bytes_sender_to_receiver\": " << receiver_results.back().bytes_received << ",\n";
+        }
+        if (!sender_results.empty()) {
+            json << "      \"bytes_receiver_to_sender\": " << sender_results.back().bytes_received << ",\n";
+        }
+        if (!receiver_results.empty()) {
+            json << "      \"intersection_correct\": "
+                 << (!options.IntersectionKnown() ? "null" : all_correct ? "true" : "false") << ",\n";
+            WritePartyJson(json, "receiver", receiver_results, sender_results.empty());
+        }
+        if (!sender_results.empty()) {
+            WritePartyJson(json, "sender", sender_results, true);
+        }
+        json << "    }" << (c + 1 == options.threads.size() ? "\n" : ",\n");
+    }
+    json << "  ]\n}\n";
+
+    if (child == 0) {
+        close(result_pipe[1]);
+        CRYPTO_Finalize();
+        _exit(0);
+    }
+    if (use_processes) {
+        close(result_pipe[0]);
+        waitpid(child, nullptr, 0);
+    }
+
+    if (options.output.empty()) {
+        cout << json.str();
+    } else {
+        ofstream out(options.output);
+        out << json.str();
+        cerr << "Benchmark results written to " << options.output << endl;
+    }
+
+    CRYPTO_Finalize();
+    return all_correct ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+// FastPSI的协议参数和消息格式：握手消息、截断mask的长度选择与打包。
+// 正确性只要求不同元素的mask在截断后不碰撞：共有 N_s·N_r 对需要比较，
+// 取 λ + log2(N_s) + log2(N_r) 位即可把误判概率压到 2^-λ 以下。
+
+#include <emmintrin.h>
+#include <omp.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// FastPSI运行参数
+struct FastPSIParams {
+    uint64_t t = 397;               // VOLE参数
+    uint64_t okvssize = 0;          // OKVS大小，0表示由接收方按集合大小自动选择
+    uint64_t band_length = 0;       // Band长度，仅在指定okvssize时使用，0表示默认上限
+    uint64_t max_band_length = 512; // 自动选择时的band长度上限
+    uint64_t okvs_security = 40;    // OKVS编码失败概率不超过 2^-okvs_security
+    uint64_t stat_security = 40;    // 统计安全参数λ
+    uint64_t mask_bytes = 0;        // 发送方mask字节数，0表示按集合大小和λ自动选择
+    uint64_t shards = 0;            // OKVS分片数，0表示按集合大小和线程数自动选择
+    uint64_t stream_chunk = 1 << 15; // A'和masks分块流水线传输的条目数，0表示整体传输
+    uint64_t okvs_type = 0;         // OkvsType：0为分片BandOKVS，其余为okvs_backend.hpp中的结构
+    bool verbose = true;            // 是否打印选定的OKVS参数
+};
+
+// 接收方完成OKVS编码后发送；各分片的键数由receiver_size和shard_count推出，不单独发送
+struct FastPSIReceiverHello {
+    uint64_t receiver_size;
+    uint64_t shard_count;
+    uint64_t okvssize;      // 最终选定的OKVS大小，即VOLE长度
+    uint64_t band_length;
+    uint64_t salt_seed;     // OKVS键的盐值编号，0表示不加盐
+    uint64_t okvs_type;     // OkvsType，解码方据此构造相同的结构
+};
+
+// 发送方在masks之前发送
+struct FastPSISenderHeader {
+    uint64_t sender_size;
+    uint64_t mask_bytes;
+};
+
+static constexpr uint64_t MIN_MASK_BYTES = 8;   // 至少覆盖MaskTable使用的低64位
+static constexpr uint64_t MAX_MASK_BYTES = 16;
+static constexpr uint64_t MAX_PEER_SET_SIZE = uint64_t(1) << 32;  // 对方声明的集合大小上限
+
+inline uint64_t CeilLog2(uint64_t n)
+{
+    return n <= 1 ? 0 : 64 - __builtin_clzll(n - 1);
+}
+
+// 截断mask的字节数：λ + log2(N_s) + log2(N_r) 位向上取整到字节
+inline uint64_t MaskBytesFor(uint64_t sender_size, uint64_t receiver_size, uint64_t stat_security)
+{
+    uint64_t bits = stat_security + CeilLog2(sender_size) + CeilLog2(receiver_size);
+    return std::clamp<uint64_t>((bits + 7) / 8, MIN_MASK_BYTES, MAX_MASK_BYTES);
+}
+
+// 取每个mask的低mask_bytes字节紧密排列写入packed
+inline void PackMasks(const __m128i* masks, size_t n, uint64_t mask_bytes, uint8_t* packed)
+{
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) {
+        memcpy(packed + i * mask_bytes, &masks[i], mask_bytes);
+    }
+}
+
+// 还原为block写入masks，高位补零
+inline void UnpackMasks(const uint8_t* packed, size_t n, uint64_t mask_bytes, __m128i* masks)
+{
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) {
+        masks[i] = _mm_setzero_si128();
+        memcpy(&masks[i], packed + i * mask_bytes, mask_bytes);
+    }
+}
+
+// 接收方把自己的masks截断到相同长度后再与解包的发送方masks比较
+inline void TruncateMasks(__m128i* masks, size_t n, uint64_t mask_bytes)
+{
+    alignas(16) uint8_t keep[16] = {0};
+    memset(keep, 0xFF, mask_bytes);
+    const __m128i keep_mask = _mm_load_si128(reinterpret_cast<const __m128i*>(keep));
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; i++) {
+        masks[i] = _mm_and_si128(masks[i], keep_mask);
+    }
+}
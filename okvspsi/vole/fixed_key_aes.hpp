@@ -0,0 +1,168 @@
+#pragma once
+
+// 固定密钥AES生成测试元素：第i个元素为 AES_k(i)。
+// AES是置换，不同下标得到的元素必然不同；双方用相同的下标区间即得到相同的元素，
+// 因此交集大小完全由区间的重叠决定。每次处理8个block以填满AES-NI流水线，并按块并行。
+// 同一实现也提供相关性鲁棒哈希 H(z) = AES_k(z) ⊕ z，用于FastPSI的输出masks。
+
+#include <immintrin.h>
+#include <wmmintrin.h>
+#include <omp.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class FixedKeyAES {
+public:
+    static constexpr size_t ROUNDS = 10;
+    static constexpr size_t PIPELINE = 8;
+
+    explicit FixedKeyAES(__m128i key = _mm_set_epi64x(0x243F6A8885A308D3ULL, 0x13198A2E03707344ULL))
+    {
+        round_keys_[0] = key;
+        round_keys_[1] = Expand(round_keys_[0], _mm_aeskeygenassist_si128(round_keys_[0], 0x01));
+        round_keys_[2] = Expand(round_keys_[1], _mm_aeskeygenassist_si128(round_keys_[1], 0x02));
+        round_keys_[3] = Expand(round_keys_[2], _mm_aeskeygenassist_si128(round_keys_[2], 0x04));
+        round_keys_[4] = Expand(round_keys_[3], _mm_aeskeygenassist_si128(round_keys_[3], 0x08));
+        round_keys_[5] = Expand(round_keys_[4], _mm_aeskeygenassist_si128(round_keys_[4], 0x10));
+        round_keys_[6] = Expand(round_keys_[5], _mm_aeskeygenassist_si128(round_keys_[5], 0x20));
+        round_keys_[7] = Expand(round_keys_[6], _mm_aeskeygenassist_si128(round_keys_[6], 0x40));
+        round_keys_[8] = Expand(round_keys_[7], _mm_aeskeygenassist_si128(round_keys_[7], 0x80));
+        round_keys_[9] = Expand(round_keys_[8], _mm_aeskeygenassist_si128(round_keys_[8], 0x1B));
+        round_keys_[10] = Expand(round_keys_[9], _mm_aeskeygenassist_si128(round_keys_[9], 0x36));
+    }
+
+    __m128i Encrypt(__m128i x) const
+    {
+        x = _mm_xor_si128(x, round_keys_[0]);
+        for (size_t r = 1; r < ROUNDS; r++) x = _mm_aesenc_si128(x, round_keys_[r]);
+        return _mm_aesenclast_si128(x, round_keys_[ROUNDS]);
+    }
+
+    using RoundKeys = __m128i[ROUNDS + 1];
+
+    // 同时展开n个密钥，各密钥的展开链交错执行。aeskeygenassist在多数Intel处理器上吞吐很低，
+    // 这里用等价的 aesenclast(广播RotWord(w3), rcon) 计算SubWord(RotWord(w3)) ⊕ rcon：
+    // 四列相同时ShiftRows不改变状态，aesenclast只剩SubBytes和异或轮密钥
+    static void ExpandKeys(const __m128i* keys, RoundKeys* round_keys, size_t n)
+    {
+        for (size_t k = 0; k < n; k++) round_keys[k][0] = keys[k];
+        ExpandRound<0x01, 1>(round_keys, n);
+        ExpandRound<0x02, 2>(round_keys, n);
+        ExpandRound<0x04, 3>(round_keys, n);
+        ExpandRound<0x08, 4>(round_keys, n);
+        ExpandRound<0x10, 5>(round_keys, n);
+        ExpandRound<0x20, 6>(round_keys, n);
+        ExpandRound<0x40, 7>(round_keys, n);
+        ExpandRound<0x80, 8>(round_keys, n);
+        ExpandRound<0x1B, 9>(round_keys, n);
+        ExpandRound<0x36, 10>(round_keys, n);
+    }
+
+    // out[j] = AES_k(counter + j)，j ∈ [0, n)，单线程
+    void EncryptCounters(uint64_t counter, __m128i* out, size_t n) const
+    {
+        size_t j = 0;
+        for (; j + PIPELINE <= n; j += PIPELINE) {
+            __m128i x[PIPELINE];
+            for (size_t k = 0; k < PIPELINE; k++) {
+                x[k] = _mm_xor_si128(_mm_set_epi64x(0, counter + j + k), round_keys_[0]);
+            }
+            for (size_t r = 1; r < ROUNDS; r++) {
+                for (size_t k = 0; k < PIPELINE; k++) x[k] = _mm_aesenc_si128(x[k], round_keys_[r]);
+            }
+            for (size_t k = 0; k < PIPELINE; k++) {
+                _mm_storeu_si128(out + j + k, _mm_aesenclast_si128(x[k], round_keys_[ROUNDS]));
+            }
+        }
+        for (; j < n; j++) {
+            out[j] = Encrypt(_mm_set_epi64x(0, counter + j));
+        }
+    }
+
+    // 相关性鲁棒哈希 out[j] = AES_k(in[j]) ⊕ in[j]，in与out可以相同，单线程
+    void Hash(const __m128i* in, __m128i* out, size_t n) const
+    {
+        size_t j = 0;
+        for (; j + PIPELINE <= n; j += PIPELINE) {
+            __m128i z[PIPELINE], x[PIPELINE];
+            for (size_t k = 0; k < PIPELINE; k++) {
+                z[k] = _mm_loadu_si128(in + j + k);
+                x[k] = _mm_xor_si128(z[k], round_keys_[0]);
+            }
+            for (size_t r = 1; r < ROUNDS; r++) {
+                for (size_t k = 0; k < PIPELINE; k++) x[k] = _mm_aesenc_si128(x[k], round_keys_[r]);
+            }
+            for (size_t k = 0; k < PIPELINE; k++) {
+                _mm_storeu_si128(out + j + k, _mm_xor_si128(_mm_aesenclast_si128(x[k], round_keys_[ROUNDS]), z[k]));
+            }
+        }
+        for (; j < n; j++) {
+            __m128i z = _mm_loadu_si128(in + j);
+            _mm_storeu_si128(out + j, _mm_xor_si128(Encrypt(z), z));
+        }
+    }
+
+private:
+    template <int RCON, size_t R>
+    static void ExpandRound(RoundKeys* round_keys, size_t n)
+    {
+        const __m128i rot_word3 = _mm_setr_epi8(13, 14, 15, 12, 13, 14, 15, 12, 13, 14, 15, 12, 13, 14, 15, 12);
+        const __m128i rcon = _mm_set1_epi32(RCON);
+        for (size_t k = 0; k < n; k++) {
+            const __m128i& prev = round_keys[k][R - 1];
+            round_keys[k][R] = Expand(prev, _mm_aesenclast_si128(_mm_shuffle_epi8(prev, rot_word3), rcon));
+        }
+    }
+
+    static __m128i Expand(__m128i key, __m128i assist)
+    {
+        assist = _mm_shuffle_epi32(assist, 0xFF);
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+        return _mm_xor_si128(key, assist);
+    }
+
+    __m128i round_keys_[ROUNDS + 1];
+};
+
+// 下标区间 [begin, begin + size) 对应的元素，按块并行生成
+inline std::vector<__m128i> GenerateRangeItems(uint64_t begin, uint64_t size)
+{
+    static constexpr size_t CHUNK_SIZE = 1 << 14;
+    static const FixedKeyAES aes;
+    std::vector<__m128i> items(size);
+    size_t chunk_num = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    #pragma omp parallel for schedule(static)
+    for (size_t c = 0; c < chunk_num; c++) {
+        size_t offset = c * CHUNK_SIZE;
+        aes.EncryptCounters(begin + offset, items.data() + offset, std::min<size_t>(CHUNK_SIZE, size - offset));
+    }
+    return items;
+}
+
+// 生成交集大小恰为intersection的两方集合：接收方为 [0, N_r)，
+// 发送方为 [0, intersection) ∪ [N_r, N_r + N_s - intersection)
+inline void GeneratePartyItems(uint64_t receiver_size, uint64_t sender_size, uint64_t intersection,
+                               std::vector<__m128i>& receiver_items, std::vector<__m128i>& sender_items)
+{
+    receiver_items = GenerateRangeItems(0, receiver_size);
+    sender_items.resize(sender_size);
+    std::copy(receiver_items.begin(), receiver_items.begin() + intersection, sender_items.begin());
+    std::vector<__m128i> rest = GenerateRangeItems(receiver_size, sender_size - intersection);
+    std::copy(rest.begin(), rest.end(), sender_items.begin() + intersection);
+}
+
+// 并行计算 out[i] = AES_k(in[i]) ⊕ in[i]，用于把VOLE-PSI的masks映射为与Δ无线性关系的输出
+inline void CorrelationRobustHash(const __m128i* in, __m128i* out, size_t n)
+{
+    static constexpr size_t CHUNK_SIZE = 1 << 14;
+    static const FixedKeyAES aes(_mm_set_epi64x(0x452821E638D01377ULL, 0xBE5466CF34E90C6CULL));
+    size_t chunk_num = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    #pragma omp parallel for schedule(static)
+    for (size_t c = 0; c < chunk_num; c++) {
+        size_t offset = c * CHUNK_SIZE;
+        aes.Hash(in + offset, out + offset, std::min<size_t>(CHUNK_SIZE, n - offset));
+    }
+}
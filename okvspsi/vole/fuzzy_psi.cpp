@@ -0,0 +1,217 @@
+#include "../mpc/vole/vole.hpp"
+#include "fuzzy_psi.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// 距离阈值模糊PSI：接收方找出所有与发送方某个IP距离不超过δ的元素。
+// 集合取自ipv4_generator生成的CSV（ip_address,organization,dataset_type），或按大小随机生成并植入close对。
+// 双方在同一进程的两个线程中运行时与明文结果比对；也可用 --role 在两个终端/主机上分别运行。
+
+struct FuzzyOptions {
+    string receiver_file;
+    string sender_file;
+    uint64_t receiver_size = 1 << 12;
+    uint64_t sender_size = 1 << 12;
+    uint64_t close = 100;           // 随机生成时植入的δ-close对数
+    uint64_t delta = 10;
+    uint64_t t = 397;
+    uint16_t port = 8095;
+    string role;                    // receiver | sender，为空时双方在同一进程运行
+    string peer = "127.0.0.1";
+    string output;                  // 命中前缀的CSV输出文件
+};
+
+FuzzyOptions ParseFuzzyOptions(int argc, char* argv[])
+{
+    FuzzyOptions options;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--receiver-file" && i + 1 < argc) {
+            options.receiver_file = argv[++i];
+        } else if (arg == "--sender-file" && i + 1 < argc) {
+            options.sender_file = argv[++i];
+        } else if (arg == "--receiver-size" && i + 1 < argc) {
+            options.receiver_size = stoull(argv[++i]);
+        } else if (arg == "--sender-size" && i + 1 < argc) {
+            options.sender_size = stoull(argv[++i]);
+        } else if (arg == "--close" && i + 1 < argc) {
+            options.close = stoull(argv[++i]);
+        } else if (arg == "--delta" && i + 1 < argc) {
+            options.delta = stoull(argv[++i]);
+        } else if (arg == "--vole-t" && i + 1 < argc) {
+            options.t = stoull(argv[++i]);
+        } else if (arg == "--port" && i + 1 < argc) {
+            options.port = static_cast<uint16_t>(stoul(argv[++i]));
+        } else if (arg == "--role" && i + 1 < argc) {
+            options.role = argv[++i];
+        } else if (arg == "--peer" && i + 1 < argc) {
+            options.peer = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            options.output = argv[++i];
+        } else {
+            cerr << "Usage: " << argv[0] << " [--receiver-file <csv>] [--sender-file <csv>]"
+                 << " [--receiver-size <n>] [--sender-size <n>] [--close <n>] [--delta <d>] [--vole-t <t>]"
+                 << " [--port <p>] [--role receiver|sender] [--peer <ip>] [--output <csv>]" << endl;
+            exit(1);
+        }
+    }
+    if (options.close > min(options.receiver_size, options.sender_size)) {
+        cerr << "Number of close pairs exceeds set size" << endl;
+        exit(1);
+    }
+    if (!options.role.empty() && options.role != "receiver" && options.role != "sender") {
+        cerr << "Unknown role: " << options.role << endl;
+        exit(1);
+    }
+    return options;
+}
+
+// 读取CSV的第一列IPv4地址，跳过表头、注释和空行
+bool ReadIpCsv(const string& filename, vector<uint32_t>& ips)
+{
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << filename << " open error" << endl;
+        return false;
+    }
+    string line;
+    getline(file, line);
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        try {
+            ips.push_back(Ipv4ToUint32(line.substr(0, line.find(','))));
+        } catch (const exception&) {
+            cerr << "Skipping malformed line: " << line << endl;
+        }
+    }
+    return true;
+}
+
+// 随机集合：接收方前close个元素在发送方各有一个偏移不超过δ的元素
+void GenerateFuzzyItems(const FuzzyOptions& options, vector<uint32_t>& receiver_ips, vector<uint32_t>& sender_ips)
+{
+    vector<block> r = GenerateRangeItems(0, options.receiver_size);
+    vector<block> s = GenerateRangeItems(options.receiver_size, options.sender_size);
+    receiver_ips.resize(options.receiver_size);
+    sender_ips.resize(options.sender_size);
+    for (size_t i = 0; i < r.size(); i++) receiver_ips[i] = uint32_t(_mm_cvtsi128_si64(r[i]));
+    for (size_t i = 0; i < s.size(); i++) sender_ips[i] = uint32_t(_mm_cvtsi128_si64(s[i]));
+    for (size_t i = 0; i < options.close; i++) {
+        uint64_t offset = (_mm_cvtsi128_si64(s[i]) >> 32) % (2 * options.delta + 1);
+        int64_t y = int64_t(receiver_ips[i]) + int64_t(offset) - int64_t(options.delta);
+        sender_ips[i] = uint32_t(clamp<int64_t>(y, 0, UINT32_MAX));
+    }
+}
+
+// 明文计算：与某个发送方元素距离不超过δ的接收方元素下标
+vector<uint64_t> PlaintextFuzzyMatches(const vector<uint32_t>& receiver_ips, vector<uint32_t> sender_ips,
+                                       uint64_t delta)
+{
+    sort(sender_ips.begin(), sender_ips.end());
+    vector<uint64_t> result;
+    for (size_t i = 0; i < receiver_ips.size(); i++) {
+        uint64_t low = receiver_ips[i] >= delta ? receiver_ips[i] - delta : 0;
+        auto it = lower_bound(sender_ips.begin(), sender_ips.end(), low);
+        if (it != sender_ips.end() && *it <= uint64_t(receiver_ips[i]) + delta) result.push_back(i);
+    }
+    return result;
+}
+
+void WriteMatches(const string& filename, const vector<uint32_t>& receiver_ips, const vector<FuzzyMatch>& matches)
+{
+    ofstream out(filename);
+    out << "receiver_index,receiver_ip,sender_range_low,sender_range_high,prefix" << endl;
+    for (const FuzzyMatch& m : matches) {
+        out << m.receiver_index << "," << Uint32ToIpv4(receiver_ips[m.receiver_index]) << ","
+            << Uint32ToIpv4(m.prefix.Low()) << "," << Uint32ToIpv4(m.prefix.High()) << ","
+            << PrefixToString(m.prefix) << endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    FuzzyOptions options = ParseFuzzyOptions(argc, argv);
+    CRYPTO_Initialize();
+
+    PrintSplitLine('-');
+    cout << "Fuzzy PSI (delta = " << options.delta << ") begins >>>" << endl;
+    PrintSplitLine('-');
+
+    vector<uint32_t> receiver_ips, sender_ips;
+    if (!options.receiver_file.empty() || !options.sender_file.empty()) {
+        if ((options.role != "sender" && !ReadIpCsv(options.receiver_file, receiver_ips)) ||
+            (options.role != "receiver" && !ReadIpCsv(options.sender_file, sender_ips))) {
+            return 1;
+        }
+    } else {
+        GenerateFuzzyItems(options, receiver_ips, sender_ips);
+    }
+
+    FastPSIParams params;
+    params.t = options.t;
+
+    bool run_receiver = options.role != "sender";
+    bool run_sender = options.role != "receiver";
+    vector<FuzzyMatch> matches;
+    auto start_time = chrono::steady_clock::now();
+    thread sender_thread;
+    if (run_sender) {
+        sender_thread = thread([&]() {
+            if (run_receiver) this_thread::sleep_for(chrono::milliseconds(100));
+            NetIO io("client", options.peer, options.port);
+            KunlunVoleBackend vole(io, params.t);
+            FuzzyPsiSend(io, vole, sender_ips, params);
+        });
+    }
+    if (run_receiver) {
+        NetIO io("server", "", options.port);
+        KunlunVoleBackend vole(io, params.t);
+        matches = FuzzyPsiRecv(io, vole, receiver_ips, options.delta, params);
+    }
+    if (sender_thread.joinable()) sender_thread.join();
+    auto end_time = chrono::steady_clock::now();
+
+    cout << "Fuzzy PSI takes: " << chrono::duration<double, milli>(end_time - start_time).count() << " ms" << endl;
+
+    int status = 0;
+    if (run_receiver) {
+        vector<uint64_t> matched_ids;
+        for (const FuzzyMatch& m : matches) matched_ids.push_back(m.receiver_index);
+        matched_ids.erase(unique(matched_ids.begin(), matched_ids.end()), matched_ids.end());
+        cout << "Matched prefixes: " << matches.size() << ", matched receiver elements: "
+             << matched_ids.size() << endl;
+        for (size_t i = 0; i < min<size_t>(5, matches.size()); i++) {
+            const FuzzyMatch& m = matches[i];
+            cout << "  " << Uint32ToIpv4(receiver_ips[m.receiver_index]) << " ~ [" << Uint32ToIpv4(m.prefix.Low())
+                 << ", " << Uint32ToIpv4(m.prefix.High()) << "]" << endl;
+        }
+        if (!options.output.empty()) WriteMatches(options.output, receiver_ips, matches);
+
+        // 双方在同一进程时与明文结果比对
+        if (run_sender) {
+            vector<uint64_t> expected = PlaintextFuzzyMatches(receiver_ips, sender_ips, options.delta);
+            PrintSplitLine('-');
+            if (matched_ids == expected) {
+                cout << "Fuzzy PSI test succeeds! Matched receiver elements agree with plaintext: "
+                     << expected.size() << endl;
+            } else {
+                cout << "Fuzzy PSI test fails! Expected: " << expected.size() << ", Got: "
+                     << matched_ids.size() << endl;
+                status = 1;
+            }
+        }
+    }
+
+    PrintSplitLine('-');
+    cout << "Fuzzy PSI ends >>>" << endl;
+    PrintSplitLine('-');
+
+    CRYPTO_Finalize();
+    return status;
+}
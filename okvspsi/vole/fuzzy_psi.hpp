@@ -0,0 +1,123 @@
+#pragma once
+
+// 距离阈值模糊PSI：双方按prefix_encoding.hpp把IP展开为前缀，前缀映射为block后作为OKVS键运行FastPSI，
+// 接收方把命中的前缀映射回自己的元素下标。每个命中前缀给出一条(接收方元素x, 前缀区间)：
+// 区间落在x的δ邻域内且至少含有一个发送方元素（w=0时区间即该元素本身）。发送方的前缀已去重，
+// 接收方不知道区间内有几个发送方元素及其具体取值，因此命中数不等于δ-close元素对的个数。
+// 双方的前缀各自去重后再求交，相邻元素共享的前缀只进入OKVS一次。
+
+#include "fastpsi.hpp"
+#include "prefix_encoding.hpp"
+#include <algorithm>
+#include <vector>
+
+// 接收方在FastPSI之前发送，发送方据此确定通配位数
+struct FuzzyPSIHello {
+    uint64_t delta;
+};
+
+// 一条匹配：接收方第receiver_index个元素，以及其δ邻域内含有发送方元素的一个前缀区间
+struct FuzzyMatch {
+    uint64_t receiver_index;
+    IpPrefix prefix;
+};
+
+// 去重后的前缀及其所属元素（CSR形式：第i个前缀属于 owners[offsets[i], offsets[i+1])）
+struct PrefixSet {
+    std::vector<uint64_t> keys;
+    std::vector<uint64_t> offsets;
+    std::vector<uint64_t> owners;
+    std::vector<block> blocks;
+};
+
+// 把 (前缀键, 元素下标) 按键排序后去重，并计算各前缀对应的PSI元素
+inline void BuildPrefixSet(std::vector<std::pair<uint64_t, uint64_t>>& entries, bool keep_owners, PrefixSet& set)
+{
+    std::sort(entries.begin(), entries.end());
+    set.keys.clear();
+    set.offsets.clear();
+    set.owners.clear();
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (i == 0 || entries[i].first != entries[i - 1].first) {
+            set.keys.push_back(entries[i].first);
+            set.offsets.push_back(set.owners.size());
+        }
+        if (keep_owners) set.owners.push_back(entries[i].second);
+    }
+    set.offsets.push_back(set.owners.size());
+    set.blocks.resize(set.keys.size());
+    PrefixKeysToBlocks(set.keys.data(), set.blocks.data(), set.keys.size());
+}
+
+inline void ExpandReceiverPrefixes(const std::vector<uint32_t>& ips, uint64_t delta, PrefixSet& set)
+{
+    std::vector<std::pair<uint64_t, uint64_t>> entries;
+    std::vector<IpPrefix> prefixes;
+    for (size_t i = 0; i < ips.size(); i++) {
+        prefixes.clear();
+        EncodeReceiverPrefixes(ips[i], delta, prefixes);
+        for (const IpPrefix& p : prefixes) entries.emplace_back(p.Key(), i);
+    }
+    BuildPrefixSet(entries, true, set);
+}
+
+inline void ExpandSenderPrefixes(const std::vector<uint32_t>& ips, uint32_t wildcard_bits, PrefixSet& set)
+{
+    std::vector<std::pair<uint64_t, uint64_t>> entries;
+    entries.reserve(ips.size() * (wildcard_bits + 1));
+    std::vector<IpPrefix> prefixes;
+    for (size_t i = 0; i < ips.size(); i++) {
+        prefixes.clear();
+        EncodeSenderPrefixes(ips[i], wildcard_bits, prefixes);
+        for (const IpPrefix& p : prefixes) entries.emplace_back(p.Key(), i);
+    }
+    BuildPrefixSet(entries, false, set);
+}
+
+// 模糊PSI接收方，返回所有命中的(接收方元素, 前缀区间)，按接收方元素下标排序
+inline std::vector<FuzzyMatch> FuzzyPsiRecv(NetIO& io, VoleBackend& vole, const std::vector<uint32_t>& ips,
+                                            uint64_t delta, const FastPSIParams& params,
+                                            FastPSIPhaseTimes* times = nullptr)
+{
+    FuzzyPSIHello hello{delta};
+    io.SendBytes(&hello, sizeof(hello));
+
+    PrefixSet set;
+    ExpandReceiverPrefixes(ips, delta, set);
+    if (params.verbose) std::cout << "Receiver prefixes: " << ips.size() << " elements -> "
+                                  << set.keys.size() << " unique prefixes" << std::endl;
+
+    std::vector<block> intersection = FastPsiRecv(io, vole, set.blocks, params, times);
+
+    // 命中的block映射回去重后的前缀，再展开到所属元素
+    MaskTable matched_table(intersection.data(), intersection.size());
+    std::vector<FuzzyMatch> matches;
+    for (size_t i : matched_table.ProbeBatch(set.blocks.data(), set.blocks.size())) {
+        IpPrefix prefix{uint32_t(set.keys[i]), uint32_t(set.keys[i] >> IP_BIT_LENGTH)};
+        for (uint64_t j = set.offsets[i]; j < set.offsets[i + 1]; j++) {
+            matches.push_back({set.owners[j], prefix});
+        }
+    }
+    std::sort(matches.begin(), matches.end(), [](const FuzzyMatch& a, const FuzzyMatch& b) {
+        return a.receiver_index != b.receiver_index ? a.receiver_index < b.receiver_index
+                                                    : a.prefix.Key() < b.prefix.Key();
+    });
+    return matches;
+}
+
+// 模糊PSI发送方
+inline void FuzzyPsiSend(NetIO& io, VoleBackend& vole, const std::vector<uint32_t>& ips,
+                         const FastPSIParams& params, FastPSIPhaseTimes* times = nullptr)
+{
+    FuzzyPSIHello hello;
+    io.ReceiveBytes(&hello, sizeof(hello));
+    uint32_t wildcard_bits = WildcardBitsFor(hello.delta);
+
+    PrefixSet set;
+    ExpandSenderPrefixes(ips, wildcard_bits, set);
+    if (params.verbose) std::cout << "Sender prefixes: " << ips.size() << " elements -> "
+                                  << set.keys.size() << " unique prefixes (wildcard bits = "
+                                  << wildcard_bits << ")" << std::endl;
+
+    FastPsiSend(io, vole, set.blocks, params, times);
+}
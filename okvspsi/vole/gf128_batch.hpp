@@ -0,0 +1,155 @@
+#pragma once
+
+// 固定乘数delta的批量GF(2^128)乘法。
+// 与 VOLE::gf128_mul 使用相同的表示：block的第i位对应x^i，模 x^128 + x^7 + x^2 + x + 1。
+// delta在整个批次中不变，其Karatsuba中间项只计算一次；每个元素3次PCLMULQDQ + 2次约简乘法。
+// 需要异或累加的场景(K = B ⊕ Δ·A')在约简前把B并入低半部分，省去一次额外的异或遍历。
+// 在支持VPCLMULQDQ的AVX-512主机上每条指令处理4个block。
+
+#include "../mpc/vole/vole.hpp"
+#include <immintrin.h>
+#include <wmmintrin.h>
+#include <omp.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace GF128Batch {
+
+// 每个OpenMP任务处理的block数，保证AVX-512路径内循环按4对齐
+static constexpr size_t CHUNK_SIZE = 4096;
+
+// 预处理后的乘数
+struct Multiplier {
+    __m128i delta;      // (d_hi, d_lo)
+    __m128i delta_mid;  // 低64位为 d_lo ^ d_hi，用于Karatsuba中间项
+};
+
+inline Multiplier MakeMultiplier(const block& delta)
+{
+    Multiplier m;
+    m.delta = delta;
+    m.delta_mid = _mm_xor_si128(delta, _mm_shuffle_epi32(delta, 0x4E));
+    return m;
+}
+
+// 256位乘积 (hi, lo) 模 x^128 + x^7 + x^2 + x + 1 约简
+// x^128 ≡ 0x87：先把hi的高64位折叠到 [64, 199) 位，溢出到hi低半部分的部分随后一起折叠
+inline __m128i Reduce(__m128i lo, __m128i hi)
+{
+    const __m128i poly = _mm_set_epi64x(0, 0x87);
+    __m128i t1 = _mm_clmulepi64_si128(hi, poly, 0x01);
+    hi = _mm_xor_si128(hi, _mm_srli_si128(t1, 8));
+    lo = _mm_xor_si128(lo, _mm_slli_si128(t1, 8));
+    __m128i t0 = _mm_clmulepi64_si128(hi, poly, 0x00);
+    return _mm_xor_si128(lo, t0);
+}
+
+// Karatsuba：a*delta 的无进位乘积，acc在约简前并入低半部分
+inline __m128i MulAcc(const Multiplier& m, __m128i a, __m128i acc)
+{
+    __m128i lo = _mm_clmulepi64_si128(a, m.delta, 0x00);
+    __m128i hi = _mm_clmulepi64_si128(a, m.delta, 0x11);
+    __m128i a_mid = _mm_xor_si128(a, _mm_shuffle_epi32(a, 0x4E));
+    __m128i mid = _mm_clmulepi64_si128(a_mid, m.delta_mid, 0x00);
+    mid = _mm_xor_si128(mid, _mm_xor_si128(lo, hi));
+    lo = _mm_xor_si128(_mm_xor_si128(lo, acc), _mm_slli_si128(mid, 8));
+    hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+    return Reduce(lo, hi);
+}
+
+#if defined(__VPCLMULQDQ__) && defined(__AVX512F__) && defined(__AVX512BW__)
+// 4个block并行的版本，各128位通道内的运算与MulAcc相同
+inline __m512i MulAcc4(__m512i delta, __m512i delta_mid, __m512i a, __m512i acc)
+{
+    const __m512i poly = _mm512_set_epi64(0, 0x87, 0, 0x87, 0, 0x87, 0, 0x87);
+    __m512i lo = _mm512_clmulepi64_epi128(a, delta, 0x00);
+    __m512i hi = _mm512_clmulepi64_epi128(a, delta, 0x11);
+    __m512i a_mid = _mm512_xor_si512(a, _mm512_shuffle_epi32(a, _MM_PERM_BADC));
+    __m512i mid = _mm512_clmulepi64_epi128(a_mid, delta_mid, 0x00);
+    mid = _mm512_xor_si512(mid, _mm512_xor_si512(lo, hi));
+    lo = _mm512_xor_si512(_mm512_xor_si512(lo, acc), _mm512_bslli_epi128(mid, 8));
+    hi = _mm512_xor_si512(hi, _mm512_bsrli_epi128(mid, 8));
+
+    __m512i t1 = _mm512_clmulepi64_epi128(hi, poly, 0x01);
+    hi = _mm512_xor_si512(hi, _mm512_bsrli_epi128(t1, 8));
+    lo = _mm512_xor_si512(lo, _mm512_bslli_epi128(t1, 8));
+    __m512i t0 = _mm512_clmulepi64_epi128(hi, poly, 0x00);
+    return _mm512_xor_si512(lo, t0);
+}
+#endif
+
+// 单线程处理一段：out[i] = (accumulate ? out[i] : 0) ^ delta * in[i]
+inline void MulRange(const Multiplier& m, const block* in, block* out, size_t n, bool accumulate)
+{
+    size_t i = 0;
+#if defined(__VPCLMULQDQ__) && defined(__AVX512F__) && defined(__AVX512BW__)
+    const __m512i delta4 = _mm512_broadcast_i32x4(m.delta);
+    const __m512i delta_mid4 = _mm512_broadcast_i32x4(m.delta_mid);
+    for (; i + 4 <= n; i += 4) {
+        __m512i a = _mm512_loadu_si512(in + i);
+        __m512i acc = accumulate ? _mm512_loadu_si512(out + i) : _mm512_setzero_si512();
+        _mm512_storeu_si512(out + i, MulAcc4(delta4, delta_mid4, a, acc));
+    }
+#endif
+    for (; i < n; i++) {
+        __m128i acc = accumulate ? _mm_loadu_si128(out + i) : _mm_setzero_si128();
+        _mm_storeu_si128(out + i, MulAcc(m, _mm_loadu_si128(in + i), acc));
+    }
+}
+
+// 用固定测试向量对比 VOLE::gf128_mul，确认两者的域表示一致
+inline bool MatchesScalar()
+{
+    static const bool matches = []() {
+        PRG::Seed seed = PRG::SetSeed();
+        std::vector<block> a = PRG::GenRandomBlocks(seed, 16);
+        std::vector<block> b = PRG::GenRandomBlocks(seed, 16);
+        for (size_t i = 0; i < a.size(); i++) {
+            Multiplier m = MakeMultiplier(a[i]);
+            block expected = VOLE::gf128_mul(a[i], b[i]);
+            block actual = MulAcc(m, b[i], _mm_setzero_si128());
+            if (!Block::Compare(expected, actual)) {
+                std::cerr << "gf128 batch kernel disagrees with VOLE::gf128_mul, using scalar path" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }();
+    return matches;
+}
+
+inline void Run(const block& delta, const block* in, block* out, size_t n, bool accumulate)
+{
+    if (!MatchesScalar()) {
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < n; i++) {
+            block product = VOLE::gf128_mul(delta, in[i]);
+            out[i] = accumulate ? (out[i] ^ product) : product;
+        }
+        return;
+    }
+
+    Multiplier m = MakeMultiplier(delta);
+    size_t chunk_num = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    #pragma omp parallel for schedule(static)
+    for (size_t c = 0; c < chunk_num; c++) {
+        size_t begin = c * CHUNK_SIZE;
+        size_t len = std::min(CHUNK_SIZE, n - begin);
+        MulRange(m, in + begin, out + begin, len, accumulate);
+    }
+}
+
+} // namespace GF128Batch
+
+// out[i] = delta * in[i]，in与out可以是同一缓冲区
+inline void gf128_mul_batch(const block& delta, const block* in, block* out, size_t n)
+{
+    GF128Batch::Run(delta, in, out, n, false);
+}
+
+// inout[i] ^= delta * in[i]
+inline void gf128_mul_xor_batch(const block& delta, const block* in, block* inout, size_t n)
+{
+    GF128Batch::Run(delta, in, inout, n, true);
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+// 把真实输入（IP、前缀、128位标识、字节串）映射为PSI元素block，双方对同一类输入使用同一函数。
+// 不超过一个block的定长输入用固定密钥AES的MMO构造 H(x) = AES_k(x) ⊕ x，每次8个block填满AES-NI流水线；
+// 字节串按Merkle-Damgård填充（0x80、补零、末8字节为比特长度）后用Davies-Meyer链
+// h_i = AES_{m_i}(h_{i-1}) ⊕ h_{i-1}，每个消息块作为AES密钥，8条消息交错处理。
+// 不同输入类型使用不同的固定密钥/IV，互不碰撞；uint32按零扩展处理，与同值的uint64得到相同的block。
+
+#include "fixed_key_aes.hpp"
+#include <omp.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static constexpr size_t HASH_TO_BLOCK_CHUNK = 1 << 14;
+
+// 定长整数（uint32/uint64）的MMO密钥
+inline const FixedKeyAES& UintHashAes()
+{
+    static const FixedKeyAES aes(_mm_set_epi64x(0xA4093822299F31D0ULL, 0x082EFA98EC4E6C89ULL));
+    return aes;
+}
+
+// 128位输入的MMO密钥
+inline const FixedKeyAES& Uint128HashAes()
+{
+    static const FixedKeyAES aes(_mm_set_epi64x(0x9216D5D98979FB1BULL, 0xD1310BA698DFB5ACULL));
+    return aes;
+}
+
+// 字节串Davies-Meyer链的初始值
+static inline const __m128i BYTES_HASH_IV = _mm_set_epi64x(0x2FFD72DBD01ADFB7ULL, 0xB8E1AFED6A267E96ULL);
+
+// 整数先零扩展为block，再分批做MMO；n个输入按块并行
+template <typename Uint>
+void HashUintsToBlocks(const Uint* in, __m128i* out, size_t n)
+{
+    static constexpr size_t BATCH = 64;
+    const FixedKeyAES& aes = UintHashAes();
+    size_t chunk_num = (n + HASH_TO_BLOCK_CHUNK - 1) / HASH_TO_BLOCK_CHUNK;
+    #pragma omp parallel for schedule(static)
+    for (size_t c = 0; c < chunk_num; c++) {
+        size_t end = std::min(n, (c + 1) * HASH_TO_BLOCK_CHUNK);
+        for (size_t i = c * HASH_TO_BLOCK_CHUNK; i < end; i += BATCH) {
+            size_t len = std::min(BATCH, end - i);
+            for (size_t j = 0; j < len; j++) out[i + j] = _mm_set_epi64x(0, int64_t(uint64_t(in[i + j])));
+            aes.Hash(out + i, out + i, len);
+        }
+    }
+}
+
+inline void HashUint32ToBlocks(const uint32_t* in, __m128i* out, size_t n) { HashUintsToBlocks(in, out, n); }
+inline void HashUint64ToBlocks(const uint64_t* in, __m128i* out, size_t n) { HashUintsToBlocks(in, out, n); }
+
+// 128位输入（如IPv6地址、UUID），in与out可以相同
+inline void HashUint128ToBlocks(const __m128i* in, __m128i* out, size_t n)
+{
+    const FixedKeyAES& aes = Uint128HashAes();
+    size_t chunk_num = (n + HASH_TO_BLOCK_CHUNK - 1) / HASH_TO_BLOCK_CHUNK;
+    #pragma omp parallel for schedule(static)
+    for (size_t c = 0; c < chunk_num; c++) {
+        size_t offset = c * HASH_TO_BLOCK_CHUNK;
+        aes.Hash(in + offset, out + offset, std::min(HASH_TO_BLOCK_CHUNK, n - offset));
+    }
+}
+
+// 填充后的块数：消息、0x80和8字节长度
+inline size_t PaddedBlockCount(size_t bytes)
+{
+    return (bytes + 1 + 8 + 15) / 16;
+}
+
+// 填充后消息的第i块
+inline __m128i PaddedBlock(std::string_view s, size_t i, size_t blocks)
+{
+    size_t begin = i * 16;
+    if (begin + 16 <= s.size()) return _mm_loadu_si128(reinterpret_cast<const __m128i*>(s.data() + begin));
+    alignas(16) uint8_t buf[16] = {0};
+    if (begin < s.size()) std::memcpy(buf, s.data() + begin, s.size() - begin);
+    if (begin <= s.size()) buf[s.size() - begin] = 0x80;
+    if (i + 1 == blocks) {
+        uint64_t bits = uint64_t(s.size()) * 8;
+        std::memcpy(buf + 8, &bits, sizeof(bits));
+    }
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(buf));
+}
+
+// 最多PIPELINE条消息交错做Davies-Meyer：每轮各条消息取一个块展开为密钥，再一起加密当前链值；
+// 已经结束的消息保持链值不变
+inline void HashBytesGroup(const std::string_view* in, __m128i* out, size_t count)
+{
+    static constexpr size_t LANES = FixedKeyAES::PIPELINE;
+    size_t blocks[LANES] = {0};
+    size_t rounds = 0;
+    __m128i h[LANES];
+    for (size_t k = 0; k < count; k++) {
+        blocks[k] = PaddedBlockCount(in[k].size());
+        rounds = std::max(rounds, blocks[k]);
+        h[k] = BYTES_HASH_IV;
+    }
+
+    FixedKeyAES::RoundKeys keys[LANES];
+    for (size_t i = 0; i < rounds; i++) {
+        size_t active[LANES];
+        __m128i m[LANES];
+        size_t active_num = 0;
+        for (size_t k = 0; k < count; k++) {
+            if (i < blocks[k]) {
+                m[active_num] = PaddedBlock(in[k], i, blocks[k]);
+                active[active_num++] = k;
+            }
+        }
+        FixedKeyAES::ExpandKeys(m, keys, active_num);
+        __m128i x[LANES];
+        for (size_t a = 0; a < active_num; a++) x[a] = _mm_xor_si128(h[active[a]], keys[a][0]);
+        for (size_t r = 1; r < FixedKeyAES::ROUNDS; r++) {
+            for (size_t a = 0; a < active_num; a++) x[a] = _mm_aesenc_si128(x[a], keys[a][r]);
+        }
+        for (size_t a = 0; a < active_num; a++) {
+            __m128i& chain = h[active[a]];
+            chain = _mm_xor_si128(_mm_aesenclast_si128(x[a], keys[a][FixedKeyAES::ROUNDS]), chain);
+        }
+    }
+    for (size_t k = 0; k < count; k++) out[k] = h[k];
+}
+
+// 字节串（如域名、邮箱、CSV字段）到block，按块并行
+inline void HashBytesToBlocks(const std::string_view* in, __m128i* out, size_t n)
+{
+    static constexpr size_t LANES = FixedKeyAES::PIPELINE;
+    size_t chunk_num = (n + HASH_TO_BLOCK_CHUNK - 1) / HASH_TO_BLOCK_CHUNK;
+    #pragma omp parallel for schedule(static)
+    for (size_t c = 0; c < chunk_num; c++) {
+        size_t end = std::min(n, (c + 1) * HASH_TO_BLOCK_CHUNK);
+        for (size_t i = c * HASH_TO_BLOCK_CHUNK; i < end; i += LANES) {
+            HashBytesGroup(in + i, out + i, std::min(LANES, end - i));
+        }
+    }
+}
+
+inline std::vector<__m128i> HashStringsToBlocks(const std::vector<std::string>& in)
+{
+    std::vector<std::string_view> views(in.begin(), in.end());
+    std::vector<__m128i> out(in.size());
+    HashBytesToBlocks(views.data(), out.data(), views.size());
+    return out;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+// FastPSI求交阶段使用的mask哈希表。
+// 开放寻址+线性探测，以mask的低64位定位槽位，只有低64位相同时才比较完整的128位。
+// masks本身是伪随机值，所以乘法散列低64位就足以均匀分布。
+// 全零block用作空槽标记，真实的全零mask单独记录。
+
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <omp.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class MaskTable {
+public:
+    MaskTable(const __m128i* masks, size_t n)
+    {
+        size_t capacity = 16;
+        while (capacity < n * LOAD_FACTOR_INV) capacity <<= 1;
+        slot_mask_ = capacity - 1;
+        shift_ = 64 - __builtin_ctzll(capacity);
+        slots_.assign(capacity, _mm_setzero_si128());
+
+        for (size_t i = 0; i < n; i++) {
+            Insert(masks[i]);
+        }
+    }
+
+    bool Contains(const __m128i& mask) const
+    {
+        if (IsZero(mask)) return has_zero_;
+        uint64_t low = Low64(mask);
+        for (size_t slot = SlotOf(low);; slot = (slot + 1) & slot_mask_) {
+            const __m128i& entry = slots_[slot];
+            if (IsZero(entry)) return false;
+            if (Low64(entry) == low && Equal(entry, mask)) return true;
+        }
+    }
+
+    // 批量探测，返回命中queries的下标（升序）
+    // 每个查询提前PREFETCH_DISTANCE个元素预取其槽位，隐藏大表的缓存缺失
+    std::vector<size_t> ProbeBatch(const __m128i* queries, size_t n) const
+    {
+        size_t chunk_num = (n + PROBE_CHUNK_SIZE - 1) / PROBE_CHUNK_SIZE;
+        std::vector<std::vector<size_t>> chunk_hits(chunk_num);
+
+        #pragma omp parallel for schedule(static)
+        for (size_t c = 0; c < chunk_num; c++) {
+            size_t begin = c * PROBE_CHUNK_SIZE;
+            size_t end = std::min(begin + PROBE_CHUNK_SIZE, n);
+            for (size_t i = begin; i < std::min(begin + PREFETCH_DISTANCE, end); i++) {
+                Prefetch(queries[i]);
+            }
+            for (size_t i = begin; i < end; i++) {
+                if (i + PREFETCH_DISTANCE < end) {
+                    Prefetch(queries[i + PREFETCH_DISTANCE]);
+                }
+                if (Contains(queries[i])) {
+                    chunk_hits[c].push_back(i);
+                }
+            }
+        }
+
+        std::vector<size_t> hits;
+        for (const auto& chunk : chunk_hits) {
+            hits.insert(hits.end(), chunk.begin(), chunk.end());
+        }
+        return hits;
+    }
+
+private:
+    static constexpr size_t LOAD_FACTOR_INV = 2;        // 装载因子不超过1/2
+    static constexpr size_t PREFETCH_DISTANCE = 16;
+    static constexpr size_t PROBE_CHUNK_SIZE = 1 << 14;
+
+    static uint64_t Low64(const __m128i& b) { return static_cast<uint64_t>(_mm_cvtsi128_si64(b)); }
+    static bool IsZero(const __m128i& b) { return _mm_testz_si128(b, b); }
+    static bool Equal(const __m128i& a, const __m128i& b)
+    {
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xFFFF;
+    }
+
+    size_t SlotOf(uint64_t low) const
+    {
+        return static_cast<size_t>((low * 0x9E3779B97F4A7C15ULL) >> shift_) & slot_mask_;
+    }
+
+    void Prefetch(const __m128i& mask) const
+    {
+        _mm_prefetch(reinterpret_cast<const char*>(&slots_[SlotOf(Low64(mask))]), _MM_HINT_T0);
+    }
+
+    void Insert(const __m128i& mask)
+    {
+        if (IsZero(mask)) {
+            has_zero_ = true;
+            return;
+        }
+        uint64_t low = Low64(mask);
+        for (size_t slot = SlotOf(low);; slot = (slot + 1) & slot_mask_) {
+            __m128i& entry = slots_[slot];
+            if (IsZero(entry)) {
+                entry = mask;
+                return;
+            }
+            if (Low64(entry) == low && Equal(entry, mask)) return;
+        }
+    }
+
+    std::vector<__m128i> slots_;
+    size_t slot_mask_ = 0;
+    int shift_ = 64;
+    bool has_zero_ = false;
+};
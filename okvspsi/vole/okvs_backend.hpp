@@ -0,0 +1,658 @@
+#pragma once
+
+// 可替换的OKVS结构。FastPSI只通过OkvsBackend编码和解码，具体结构由握手中的OKVS类型决定：
+//   band         BandOKVS库（默认，支持分片，参数见okvs_params.hpp）
+//   random-band  本地实现的随机带状OKVS：每个键对应长度w的随机带，按起点排序后带内高斯消元
+//   paxos        三哈希乱码布谷鸟表（PaXoS）：稀疏部分剥离（peeling），剩余2-core与稠密列一起高斯消元
+// 各结构的扩张率、编码/解码代价不同，用okvs_bench按集合大小比较后选择。
+
+#include "okvs_params.hpp"
+#include "block_view.hpp"
+#include "fixed_key_aes.hpp"
+#include "sorted_decode.hpp"
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+enum class OkvsType : uint64_t {
+    BAND = 0,
+    RANDOM_BAND = 1,
+    PAXOS = 2,
+};
+
+inline const char* OkvsTypeName(OkvsType type)
+{
+    switch (type) {
+        case OkvsType::BAND: return "band";
+        case OkvsType::RANDOM_BAND: return "random-band";
+        case OkvsType::PAXOS: return "paxos";
+    }
+    return "unknown";
+}
+
+inline bool OkvsTypeFromName(const std::string& name, OkvsType& type)
+{
+    for (OkvsType t : {OkvsType::BAND, OkvsType::RANDOM_BAND, OkvsType::PAXOS}) {
+        if (name == OkvsTypeName(t)) {
+            type = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+class OkvsBackend {
+public:
+    virtual ~OkvsBackend() = default;
+    virtual OkvsType Type() const = 0;
+    const char* Name() const { return OkvsTypeName(Type()); }
+
+    // 编码n个键、失败概率不超过 2^-stat_security 时的输出长度m
+    virtual uint64_t SizeFor(uint64_t n, uint64_t stat_security) const = 0;
+    // 以 (n, m) 初始化后，编码失败概率的估计值 log2
+    virtual double FailureLog2(uint64_t n, uint64_t m) const = 0;
+    // 结构参数（带长度等），随握手传给解码方；没有时为0
+    virtual uint64_t Width() const = 0;
+
+    virtual void Init(uint64_t n, uint64_t m) = 0;
+    virtual bool Encode(const __m128i* keys, const __m128i* values, __m128i* out) = 0;
+    virtual void Decode(const __m128i* keys, const __m128i* in, __m128i* out, uint64_t n) const = 0;
+
+    // 每个键与m无关的行哈希（block数）。解码方对固定的键集合反复解码时可用HashRows缓存，
+    // 再用DecodeHashed跳过逐键AES，m变化时缓存仍然有效；0表示不支持（BandOKVS库不公开键的位置）
+    virtual uint64_t RowHashBlocks() const { return 0; }
+    virtual void HashRows(const __m128i*, __m128i*, uint64_t) const {}
+    virtual void DecodeHashed(const __m128i*, const __m128i*, __m128i*, uint64_t) const {}
+
+    // 大向量上按位置排序、分块预取的解码（sorted_decode.hpp），默认开启；BandOKVS库不公开键的位置，不受影响
+    void SetSortedDecode(bool enabled) { sorted_decode_ = enabled; }
+
+protected:
+    bool sorted_decode_ = true;
+};
+
+// 由带状OKVS的拟合曲线得到扩张率为epsilon、带长度为w时的失败概率估计
+inline double BandFailureLog2(double epsilon, uint64_t w)
+{
+    const OkvsEpsilonFit* fit = nullptr;
+    for (const OkvsEpsilonFit& f : OKVS_EPSILON_FITS) {
+        if (f.epsilon <= epsilon + 1e-9) fit = &f;
+    }
+    if (fit == nullptr) return 0;
+    return std::min(0.0, -(fit->a * double(w) - fit->b));
+}
+
+// 带状OKVS在给定w下满足stat_security的最小长度，都不满足时取最大的ε
+inline uint64_t BandSizeFor(uint64_t n, uint64_t w, uint64_t stat_security)
+{
+    for (const OkvsEpsilonFit& fit : OKVS_EPSILON_FITS) {
+        if (BandLengthFor(fit, stat_security) <= w) return OkvsSizeFor(fit.epsilon, w, n, 1);
+    }
+    return OkvsSizeFor(OKVS_EPSILON_FITS[OKVS_EPSILON_FIT_NUM - 1].epsilon, w, n, 1);
+}
+
+// BandOKVS库，单个实例；FastPSI的分片编码仍直接使用ShardedBandOkvs
+class BandOkvsBackend : public OkvsBackend {
+public:
+    explicit BandOkvsBackend(uint64_t w) : w_(w) {}
+
+    OkvsType Type() const override { return OkvsType::BAND; }
+    uint64_t SizeFor(uint64_t n, uint64_t stat_security) const override { return BandSizeFor(n, w_, stat_security); }
+    double FailureLog2(uint64_t n, uint64_t m) const override { return BandFailureLog2(double(m) / n - 1.0, w_); }
+    uint64_t Width() const override { return w_; }
+
+    void Init(uint64_t n, uint64_t m) override { okvs_.Init(n, m, w_); }
+
+    bool Encode(const __m128i* keys, const __m128i* values, __m128i* out) override
+    {
+        return okvs_.Encode(ToOc(keys), ToOc(values), reinterpret_cast<oc::block*>(out));
+    }
+
+    void Decode(const __m128i* keys, const __m128i* in, __m128i* out, uint64_t n) const override
+    {
+        okvs_.Decode(ToOc(keys), ToOc(in), reinterpret_cast<oc::block*>(out), n);
+    }
+
+private:
+    static oc::block* ToOc(const __m128i* p) { return reinterpret_cast<oc::block*>(const_cast<__m128i*>(p)); }
+
+    uint64_t w_;
+    mutable band_okvs::BandOkvs okvs_;
+};
+
+// 随机带状OKVS：键k对应起点 s ∈ [0, m-w] 和首位为1的w位随机带，P满足 ⊕_{j: band_j=1} P[s+j] = value。
+// 编码时按起点排序，每行规范化为“首位为1、起点即首位所在列”，与该列已有主元行异或后再次规范化，
+// 因此所有行都保持在w位之内；最后从高列到低列回代。w必须是64的倍数。
+class RandomBandOkvs : public OkvsBackend {
+public:
+    static constexpr uint64_t MAX_WORDS = 8;
+
+    explicit RandomBandOkvs(uint64_t w) : words_(std::clamp<uint64_t>((w + 63) / 64, 1, MAX_WORDS)) {}
+
+    OkvsType Type() const override { return OkvsType::RANDOM_BAND; }
+    uint64_t SizeFor(uint64_t n, uint64_t stat_security) const override { return BandSizeFor(n, Width(), stat_security); }
+    double FailureLog2(uint64_t n, uint64_t m) const override { return BandFailureLog2(double(m) / n - 1.0, Width()); }
+    uint64_t Width() const override { return words_ * 64; }
+
+    void Init(uint64_t n, uint64_t m) override
+    {
+        n_ = n;
+        m_ = std::max(m, Width());
+    }
+
+    bool Encode(const __m128i* keys, const __m128i* values, __m128i* out) override
+    {
+        std::vector<Row> rows(n_);
+        #pragma omp parallel for schedule(static)
+        for (uint64_t i = 0; i < n_; i++) {
+            MakeRow(keys[i], rows[i]);
+            rows[i].value = values[i];
+        }
+        std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.start < b.start; });
+
+        // pivot_of[c]：以列c为首位的主元行
+        std::vector<uint32_t> pivot_of(m_, UINT32_MAX);
+        for (uint64_t i = 0; i < n_; i++) {
+            Row& row = rows[i];
+            while (true) {
+                if (!Normalize(row)) {
+                    // 与已有行线性相关：值也必须抵消为0（重复键），否则无解
+                    if (!_mm_testz_si128(row.value, row.value)) return false;
+                    break;
+                }
+                uint32_t& pivot = pivot_of[row.start];
+                if (pivot == UINT32_MAX) {
+                    pivot = uint32_t(i);
+                    break;
+                }
+                const Row& p = rows[pivot];
+                for (uint64_t w = 0; w < words_; w++) row.bits[w] ^= p.bits[w];
+                row.value = _mm_xor_si128(row.value, p.value);
+            }
+        }
+
+        // 回代：主元行只涉及不低于其首位的列，从高到低依次确定；非主元列置0
+        for (uint64_t c = m_; c-- > 0;) {
+            if (pivot_of[c] == UINT32_MAX) {
+                out[c] = _mm_setzero_si128();
+                continue;
+            }
+            const Row& row = rows[pivot_of[c]];
+            __m128i v = row.value;
+            for (uint64_t w = 0; w < words_; w++) {
+                uint64_t bits = row.bits[w] & (w == 0 ? ~uint64_t(1) : ~uint64_t(0));
+                while (bits != 0) {
+                    v = _mm_xor_si128(v, out[c + w * 64 + __builtin_ctzll(bits)]);
+                    bits &= bits - 1;
+                }
+            }
+            out[c] = v;
+        }
+        return true;
+    }
+
+    void Decode(const __m128i* keys, const __m128i* in, __m128i* out, uint64_t n) const override
+    {
+        DecodeRows(in, out, n, [&](uint64_t i) { return RowAes().Encrypt(keys[i]); },
+                   [&](uint64_t i, Row& row) { MakeRow(keys[i], row); });
+    }
+
+    // 第一个block给出起点和第一个字，其余每个block给出两个字
+    uint64_t RowHashBlocks() const override { return 1 + words_ / 2; }
+
+    void HashRows(const __m128i* keys, __m128i* hashes, uint64_t n) const override
+    {
+        uint64_t k = RowHashBlocks();
+        #pragma omp parallel for schedule(static)
+        for (uint64_t i = 0; i < n; i++) HashKey(keys[i], hashes + i * k);
+    }
+
+    void DecodeHashed(const __m128i* hashes, const __m128i* in, __m128i* out, uint64_t n) const override
+    {
+        uint64_t k = RowHashBlocks();
+        DecodeRows(in, out, n, [&](uint64_t i) { return hashes[i * k]; },
+                   [&](uint64_t i, Row& row) { RowFromHashes(hashes + i * k, row); });
+    }
+
+private:
+    struct Row {
+        uint64_t start;
+        uint64_t bits[MAX_WORDS];
+        __m128i value;
+    };
+
+    // first_hash(i)返回第i个键的第一个行哈希（决定起点），make_row(i, row)生成第i个键的行
+    template <typename FirstHash, typename MakeRowFn>
+    void DecodeRows(const __m128i* in, __m128i* out, uint64_t n, FirstHash first_hash, MakeRowFn make_row) const
+    {
+        if (!sorted_decode_ || !UseSortedDecode(n, m_)) {
+            #pragma omp parallel for schedule(static)
+            for (uint64_t i = 0; i < n; i++) {
+                Row row;
+                make_row(i, row);
+                out[i] = Eval(in, row);
+            }
+            return;
+        }
+
+        // 起点只需要第一个行哈希
+        std::vector<uint64_t> starts(n);
+        #pragma omp parallel for schedule(static)
+        for (uint64_t i = 0; i < n; i++) starts[i] = StartOf(first_hash(i));
+        std::vector<uint32_t> order;
+        BucketByPosition(starts, m_, order);
+        std::vector<uint64_t>().swap(starts);
+
+        // 相邻行的窗口大部分重叠，只需预取窗口的首尾两端
+        DecodeInOrder<Row>(order, out, make_row,
+            [&](const Row& row) {
+                _mm_prefetch(reinterpret_cast<const char*>(in + row.start), _MM_HINT_T0);
+                _mm_prefetch(reinterpret_cast<const char*>(in + row.start + Width() - 1), _MM_HINT_T0);
+            },
+            [&](const Row& row) { return Eval(in, row); });
+    }
+
+    static const FixedKeyAES& RowAes()
+    {
+        static const FixedKeyAES aes(_mm_set_epi64x(0x3F84D5B5B5470917ULL, 0x9216D5D98979FB1BULL));
+        return aes;
+    }
+
+    uint64_t StartOf(const __m128i& h) const
+    {
+        return uint64_t((unsigned __int128)uint64_t(_mm_cvtsi128_si64(h)) * (m_ - Width() + 1) >> 64);
+    }
+
+    __m128i Eval(const __m128i* in, const Row& row) const
+    {
+        __m128i v = _mm_setzero_si128();
+        for (uint64_t w = 0; w < words_; w++) {
+            uint64_t bits = row.bits[w];
+            while (bits != 0) {
+                v = _mm_xor_si128(v, in[row.start + w * 64 + __builtin_ctzll(bits)]);
+                bits &= bits - 1;
+            }
+        }
+        return v;
+    }
+
+    // 第一次加密给出起点和第一个字，其余各字由键与下标异或后加密得到
+    void HashKey(const __m128i& key, __m128i* h) const
+    {
+        const FixedKeyAES& aes = RowAes();
+        h[0] = aes.Encrypt(key);
+        for (uint64_t w = 1, k = 1; w < words_; w += 2, k++) {
+            h[k] = aes.Encrypt(_mm_xor_si128(key, _mm_set_epi64x(0, int64_t(w))));
+        }
+    }
+
+    void RowFromHashes(const __m128i* h, Row& row) const
+    {
+        row.start = StartOf(h[0]);
+        row.bits[0] = uint64_t(_mm_extract_epi64(h[0], 1)) | 1;
+        for (uint64_t w = 1, k = 1; w < words_; w += 2, k++) {
+            row.bits[w] = uint64_t(_mm_cvtsi128_si64(h[k]));
+            if (w + 1 < words_) row.bits[w + 1] = uint64_t(_mm_extract_epi64(h[k], 1));
+        }
+    }
+
+    void MakeRow(const __m128i& key, Row& row) const
+    {
+        __m128i h[1 + MAX_WORDS / 2];
+        HashKey(key, h);
+        RowFromHashes(h, row);
+    }
+
+    // 右移到首位为1并相应推进起点；全零时返回false
+    bool Normalize(Row& row) const
+    {
+        uint64_t first_word = 0;
+        while (first_word < words_ && row.bits[first_word] == 0) first_word++;
+        if (first_word == words_) return false;
+        uint64_t shift = first_word * 64 + __builtin_ctzll(row.bits[first_word]);
+        if (shift == 0) return true;
+        uint64_t word_shift = shift / 64, bit_shift = shift % 64;
+        for (uint64_t w = 0; w < words_; w++) {
+            uint64_t src = w + word_shift;
+            uint64_t lo = src < words_ ? row.bits[src] : 0;
+            uint64_t hi = src + 1 < words_ ? row.bits[src + 1] : 0;
+            row.bits[w] = bit_shift == 0 ? lo : (lo >> bit_shift) | (hi << (64 - bit_shift));
+        }
+        row.start += shift;
+        return true;
+    }
+
+    uint64_t words_;
+    uint64_t n_ = 0;
+    uint64_t m_ = 0;
+};
+
+// PaXoS：m = 3·r + DENSE_BITS，键k对应三个互不相同区域中的各一列和DENSE_BITS位稠密向量。
+// 稀疏部分 r ≥ 1.3n/3 高于三超图的剥离阈值（1.222n），2-core以高概率为空或很小，
+// 由稠密列吸收；失败概率约为 2^-(DENSE_BITS - |core|)。
+class PaxosOkvs : public OkvsBackend {
+public:
+    static constexpr uint64_t DENSE_BITS = 64;
+    static constexpr double SPARSE_EXPANSION = 1.3;
+    static constexpr uint64_t MAX_CORE_ROWS = 1 << 12;
+
+    OkvsType Type() const override { return OkvsType::PAXOS; }
+
+    uint64_t SizeFor(uint64_t n, uint64_t) const override
+    {
+        uint64_t region = std::max<uint64_t>(1, uint64_t(std::ceil(SPARSE_EXPANSION * n / 3)));
+        return 3 * region + DENSE_BITS;
+    }
+
+    double FailureLog2(uint64_t n, uint64_t m) const override
+    {
+        if (m < DENSE_BITS + 3 || double(m - DENSE_BITS) < 1.23 * n) return 0;
+        return -double(DENSE_BITS - 2);
+    }
+
+    uint64_t Width() const override { return 0; }
+
+    void Init(uint64_t n, uint64_t m) override
+    {
+        n_ = n;
+        region_ = std::max<uint64_t>(1, (std::max(m, DENSE_BITS + 3) - DENSE_BITS) / 3);
+        sparse_ = 3 * region_;
+        m_ = m;
+    }
+
+    bool Encode(const __m128i* keys, const __m128i* values, __m128i* out) override
+    {
+        std::vector<Row> rows(n_);
+        #pragma omp parallel for schedule(static)
+        for (uint64_t i = 0; i < n_; i++) MakeRow(keys[i], rows[i]);
+
+        // 列到行的邻接表（CSR）和列的度
+        std::vector<uint32_t> degree(sparse_, 0);
+        for (const Row& row : rows) {
+            for (uint64_t c : row.cols) degree[c]++;
+        }
+        std::vector<uint64_t> offsets(sparse_ + 1, 0);
+        for (uint64_t c = 0; c < sparse_; c++) offsets[c + 1] = offsets[c] + degree[c];
+        std::vector<uint32_t> adjacency(offsets[sparse_]);
+        {
+            std::vector<uint64_t> cursor(offsets.begin(), offsets.end() - 1);
+            for (uint64_t i = 0; i < n_; i++) {
+                for (uint64_t c : rows[i].cols) adjacency[cursor[c]++] = uint32_t(i);
+            }
+        }
+
+        // 剥离：反复取出度为1的列，其唯一的未剥离行以该列为主元
+        std::vector<uint8_t> peeled(n_, 0);
+        std::vector<std::pair<uint32_t, uint64_t>> peel_order;   // (行, 主元列)
+        peel_order.reserve(n_);
+        std::vector<uint64_t> queue;
+        for (uint64_t c = 0; c < sparse_; c++) {
+            if (degree[c] == 1) queue.push_back(c);
+        }
+        while (!queue.empty()) {
+            uint64_t c = queue.back();
+            queue.pop_back();
+            if (degree[c] != 1) continue;
+            uint32_t r = UINT32_MAX;
+            for (uint64_t j = offsets[c]; j < offsets[c + 1]; j++) {
+                if (!peeled[adjacency[j]]) {
+                    r = adjacency[j];
+                    break;
+                }
+            }
+            peeled[r] = 1;
+            peel_order.emplace_back(r, c);
+            for (uint64_t other : rows[r].cols) {
+                if (--degree[other] == 1) queue.push_back(other);
+            }
+        }
+
+        std::fill(out, out + m_, _mm_setzero_si128());
+        if (peel_order.size() < n_ && !SolveCore(rows, peeled, values, out)) return false;
+
+        // 稠密部分已确定，按剥离的逆序回代稀疏主元
+        DenseTable table;
+        BuildDenseTable(out + sparse_, table);
+        for (size_t k = peel_order.size(); k-- > 0;) {
+            auto [r, pivot] = peel_order[k];
+            const Row& row = rows[r];
+            __m128i v = _mm_xor_si128(values[r], DenseXor(table, row.dense));
+            for (uint64_t c : row.cols) {
+                if (c != pivot) v = _mm_xor_si128(v, out[c]);
+            }
+            out[pivot] = v;
+        }
+        return true;
+    }
+
+    void Decode(const __m128i* keys, const __m128i* in, __m128i* out, uint64_t n) const override
+    {
+        DecodeRows(in, out, n, [&](uint64_t i, Row& row) { MakeRow(keys[i], row); });
+    }
+
+    uint64_t RowHashBlocks() const override { return 2; }
+
+    void HashRows(const __m128i* keys, __m128i* hashes, uint64_t n) const override
+    {
+        #pragma omp parallel for schedule(static)
+        for (uint64_t i = 0; i < n; i++) HashKey(keys[i], hashes + 2 * i);
+    }
+
+    void DecodeHashed(const __m128i* hashes, const __m128i* in, __m128i* out, uint64_t n) const override
+    {
+        DecodeRows(in, out, n, [&](uint64_t i, Row& row) { RowFromHashes(hashes + 2 * i, row); });
+    }
+
+private:
+    struct Row {
+        uint64_t cols[3];
+        uint64_t dense;
+    };
+
+    template <typename MakeRowFn>
+    void DecodeRows(const __m128i* in, __m128i* out, uint64_t n, MakeRowFn make_row) const
+    {
+        DenseTable table;
+        BuildDenseTable(in + sparse_, table);
+        auto eval = [&](const Row& row) {
+            __m128i v = DenseXor(table, row.dense);
+            for (uint64_t c : row.cols) v = _mm_xor_si128(v, in[c]);
+            return v;
+        };
+        if (!sorted_decode_ || !UseSortedDecode(n, m_)) {
+            #pragma omp parallel for schedule(static)
+            for (uint64_t i = 0; i < n; i++) {
+                Row row;
+                make_row(i, row);
+                out[i] = eval(row);
+            }
+            return;
+        }
+
+        // 三列分布在三个区域，按其中一列排序只让三分之一的访问变为顺序，抵不上排序的代价；
+        // 这里保持输入顺序，只分块并提前预取三列
+        std::vector<uint32_t> order(n);
+        std::iota(order.begin(), order.end(), uint32_t(0));
+        DecodeInOrder<Row>(order, out, make_row,
+            [&](const Row& row) {
+                for (uint64_t c : row.cols) _mm_prefetch(reinterpret_cast<const char*>(in + c), _MM_HINT_T0);
+            },
+            eval);
+    }
+
+    // 稠密向量按字节查表：table[t][b] = ⊕_{i: b的第i位为1} dense[8t + i]
+    using DenseTable = std::vector<__m128i>;
+
+    static void BuildDenseTable(const __m128i* dense, DenseTable& table)
+    {
+        table.assign(8 * 256, _mm_setzero_si128());
+        for (uint64_t t = 0; t < 8; t++) {
+            __m128i* tt = table.data() + t * 256;
+            for (uint64_t b = 1; b < 256; b++) {
+                tt[b] = _mm_xor_si128(tt[b & (b - 1)], dense[8 * t + __builtin_ctzll(b)]);
+            }
+        }
+    }
+
+    static __m128i DenseXor(const DenseTable& table, uint64_t bits)
+    {
+        __m128i v = _mm_setzero_si128();
+        for (uint64_t t = 0; t < 8; t++) {
+            v = _mm_xor_si128(v, table[t * 256 + ((bits >> (8 * t)) & 0xFF)]);
+        }
+        return v;
+    }
+
+    static const FixedKeyAES& RowAes()
+    {
+        static const FixedKeyAES aes(_mm_set_epi64x(0xC0AC29B7C97C50DDULL, 0x3F84D5B5B5470917ULL));
+        return aes;
+    }
+
+    uint64_t Reduce(uint64_t x) const { return uint64_t((unsigned __int128)x * region_ >> 64); }
+
+    static void HashKey(const __m128i& key, __m128i* h)
+    {
+        const FixedKeyAES& aes = RowAes();
+        h[0] = aes.Encrypt(key);
+        h[1] = aes.Encrypt(_mm_xor_si128(key, _mm_set_epi64x(0, 1)));
+    }
+
+    void RowFromHashes(const __m128i* h, Row& row) const
+    {
+        row.cols[0] = Reduce(uint64_t(_mm_cvtsi128_si64(h[0])));
+        row.cols[1] = region_ + Reduce(uint64_t(_mm_extract_epi64(h[0], 1)));
+        row.cols[2] = 2 * region_ + Reduce(uint64_t(_mm_cvtsi128_si64(h[1])));
+        row.dense = uint64_t(_mm_extract_epi64(h[1], 1));
+    }
+
+    void MakeRow(const __m128i& key, Row& row) const
+    {
+        __m128i h[2];
+        HashKey(key, h);
+        RowFromHashes(h, row);
+    }
+
+    // 未被剥离的行（2-core）：变量为其涉及的稀疏列和全部稠密列，高斯消元后把解写入out
+    bool SolveCore(const std::vector<Row>& rows, const std::vector<uint8_t>& peeled,
+                   const __m128i* values, __m128i* out) const
+    {
+        std::vector<uint32_t> core;
+        for (uint64_t i = 0; i < n_; i++) {
+            if (!peeled[i]) core.push_back(uint32_t(i));
+        }
+        if (core.size() > MAX_CORE_ROWS) return false;
+
+        // 稀疏列重新编号为 0..k-1，稠密列为 k..k+DENSE_BITS-1
+        std::vector<uint64_t> core_cols;
+        for (uint32_t r : core) core_cols.insert(core_cols.end(), rows[r].cols, rows[r].cols + 3);
+        std::sort(core_cols.begin(), core_cols.end());
+        core_cols.erase(std::unique(core_cols.begin(), core_cols.end()), core_cols.end());
+        uint64_t vars = core_cols.size() + DENSE_BITS;
+        uint64_t words = (vars + 63) / 64;
+
+        struct Equation {
+            std::vector<uint64_t> bits;
+            __m128i value;
+            uint64_t pivot;
+        };
+        std::vector<Equation> pivots;
+        for (uint32_t r : core) {
+            Equation e{std::vector<uint64_t>(words, 0), values[r], 0};
+            for (uint64_t c : rows[r].cols) {
+                uint64_t v = std::lower_bound(core_cols.begin(), core_cols.end(), c) - core_cols.begin();
+                e.bits[v / 64] ^= uint64_t(1) << (v % 64);
+            }
+            for (uint64_t j = 0; j < DENSE_BITS; j++) {
+                if ((rows[r].dense >> j) & 1) {
+                    uint64_t v = core_cols.size() + j;
+                    e.bits[v / 64] ^= uint64_t(1) << (v % 64);
+                }
+            }
+            // 依创建顺序消去已有主元列
+            for (const Equation& p : pivots) {
+                if ((e.bits[p.pivot / 64] >> (p.pivot % 64)) & 1) {
+                    for (uint64_t w = 0; w < words; w++) e.bits[w] ^= p.bits[w];
+                    e.value = _mm_xor_si128(e.value, p.value);
+                }
+            }
+            uint64_t w = 0;
+            while (w < words && e.bits[w] == 0) w++;
+            if (w == words) {
+                if (!_mm_testz_si128(e.value, e.value)) return false;
+                continue;
+            }
+            e.pivot = w * 64 + __builtin_ctzll(e.bits[w]);
+            pivots.push_back(std::move(e));
+        }
+
+        // 逆序回代，自由变量取0
+        std::vector<__m128i> solution(vars, _mm_setzero_si128());
+        for (size_t k = pivots.size(); k-- > 0;) {
+            const Equation& e = pivots[k];
+            __m128i v = e.value;
+            for (uint64_t w = 0; w < words; w++) {
+                uint64_t bits = e.bits[w];
+                while (bits != 0) {
+                    uint64_t var = w * 64 + __builtin_ctzll(bits);
+                    if (var != e.pivot) v = _mm_xor_si128(v, solution[var]);
+                    bits &= bits - 1;
+                }
+            }
+            solution[e.pivot] = v;
+        }
+        for (uint64_t v = 0; v < core_cols.size(); v++) out[core_cols[v]] = solution[v];
+        for (uint64_t j = 0; j < DENSE_BITS; j++) out[sparse_ + j] = solution[core_cols.size() + j];
+        return true;
+    }
+
+    uint64_t n_ = 0;
+    uint64_t region_ = 1;
+    uint64_t sparse_ = 3;
+    uint64_t m_ = 0;
+};
+
+// width为带状结构的带长度，PaXoS忽略
+inline std::unique_ptr<OkvsBackend> MakeOkvsBackend(OkvsType type, uint64_t width)
+{
+    switch (type) {
+        case OkvsType::BAND: return std::make_unique<BandOkvsBackend>(width);
+        case OkvsType::RANDOM_BAND: return std::make_unique<RandomBandOkvs>(width);
+        case OkvsType::PAXOS: return std::make_unique<PaxosOkvs>();
+    }
+    return nullptr;
+}
+
+// 非分片结构的编码：键加盐的重试方式与EncodeWithRetry相同，多次失败后把长度放大一档
+inline bool EncodeWithBackend(std::vector<__m128i>& elems, OkvsBackend& okvs, uint64_t stat_security,
+                              uint64_t initial_size, OkvsEncoding& enc)
+{
+    static constexpr double GROWTH = 1.1;
+    static constexpr size_t MAX_GROWTH_STEPS = 4;
+    uint64_t n = elems.size();
+    uint64_t m = initial_size != 0 ? initial_size : okvs.SizeFor(n, stat_security);
+    for (size_t step = 0; step <= MAX_GROWTH_STEPS; step++) {
+        for (uint64_t salt_seed = 0; salt_seed < OKVS_MAX_RESEEDS; salt_seed++) {
+            enc.salt_seed = salt_seed;
+            enc.salted_keys = SaltKeys(elems, salt_seed);
+            std::vector<__m128i>& keys = salt_seed == 0 ? elems : enc.salted_keys;
+            enc.params = {m, okvs.Width(), double(m) / std::max<uint64_t>(n, 1) - 1.0, 0};
+            enc.output.assign(m, _mm_setzero_si128());
+            enc.attempts++;
+            okvs.Init(n, m);
+            if (okvs.Encode(keys.data(), elems.data(), enc.output.data())) return true;
+            std::cerr << okvs.Name() << " OKVS encoding failed (m = " << m << ", salt " << salt_seed
+                      << "), retrying" << std::endl;
+        }
+        m = uint64_t(std::ceil(m * GROWTH));
+    }
+    return false;
+}
@@ -0,0 +1,161 @@
+#include "okvs_backend.hpp"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// OKVS结构基准测试：对每个集合大小N和每种结构，按目标统计安全性选择长度m，
+// 重复编码/解码随机键值对，输出编码、解码耗时的中位数、扩张率m/N、估计的失败概率，
+// 以及实际观察到的编码失败次数（JSON）。解码分别按键排序分块和按输入顺序各计时一次，
+// 两者结果都与原值比对。
+
+struct OkvsBenchOptions {
+    vector<uint64_t> sizes;
+    vector<OkvsType> types;
+    uint64_t band_length = 128;     // band与random-band的带长度
+    uint64_t security = 40;         // 目标统计安全性λ
+    size_t trials = 5;
+    string output;                  // JSON输出文件，为空时打印到标准输出
+};
+
+OkvsBenchOptions ParseOkvsBenchOptions(int argc, char* argv[])
+{
+    OkvsBenchOptions options;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            stringstream ss(argv[++i]);
+            string item;
+            while (getline(ss, item, ',')) {
+                if (!item.empty()) options.sizes.push_back(max<uint64_t>(1, stoull(item)));
+            }
+        } else if (arg == "--okvs" && i + 1 < argc) {
+            stringstream ss(argv[++i]);
+            string item;
+            while (getline(ss, item, ',')) {
+                OkvsType type;
+                if (!OkvsTypeFromName(item, type)) {
+                    cerr << "Unknown OKVS type: " << item << endl;
+                    exit(1);
+                }
+                options.types.push_back(type);
+            }
+        } else if (arg == "--band-length" && i + 1 < argc) {
+            options.band_length = stoull(argv[++i]);
+        } else if (arg == "--security" && i + 1 < argc) {
+            options.security = stoull(argv[++i]);
+        } else if (arg == "--trials" && i + 1 < argc) {
+            options.trials = max<size_t>(1, stoul(argv[++i]));
+        } else if (arg == "--output" && i + 1 < argc) {
+            options.output = argv[++i];
+        } else {
+            cerr << "Usage: " << argv[0] << " [--sizes <n,n,...>] [--okvs band,random-band,paxos]"
+                 << " [--band-length <w>] [--security <lambda>] [--trials <n>] [--output <file>]" << endl;
+            exit(1);
+        }
+    }
+    if (options.sizes.empty()) options.sizes = {1 << 12, 1 << 16, 1 << 20};
+    if (options.types.empty()) options.types = {OkvsType::BAND, OkvsType::RANDOM_BAND, OkvsType::PAXOS};
+    return options;
+}
+
+struct OkvsRunResult {
+    double encode_ms = 0;
+    double decode_ms = 0;
+    double unsorted_decode_ms = 0;
+    size_t failures = 0;
+    size_t decode_errors = 0;
+};
+
+double Median(vector<double> values)
+{
+    if (values.empty()) return 0;
+    sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+OkvsRunResult RunOkvs(OkvsBackend& okvs, uint64_t n, uint64_t m, size_t trials)
+{
+    OkvsRunResult result;
+    vector<double> encode_times, decode_times, unsorted_decode_times;
+    vector<__m128i> values(n), output(m), decoded(n);
+    for (size_t trial = 0; trial < trials; trial++) {
+        // 每次使用不同的键，值为键的哈希
+        vector<__m128i> keys = GenerateRangeItems(trial * n, n);
+        CorrelationRobustHash(keys.data(), values.data(), n);
+
+        okvs.Init(n, m);
+        auto start = chrono::steady_clock::now();
+        bool ok = okvs.Encode(keys.data(), values.data(), output.data());
+        auto mid = chrono::steady_clock::now();
+        encode_times.push_back(chrono::duration<double, milli>(mid - start).count());
+        if (!ok) {
+            result.failures++;
+            continue;
+        }
+
+        for (bool sorted : {true, false}) {
+            okvs.SetSortedDecode(sorted);
+            mid = chrono::steady_clock::now();
+            okvs.Decode(keys.data(), output.data(), decoded.data(), n);
+            auto end = chrono::steady_clock::now();
+            (sorted ? decode_times : unsorted_decode_times).push_back(chrono::duration<double, milli>(end - mid).count());
+            for (uint64_t i = 0; i < n; i++) {
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(decoded[i], values[i])) != 0xFFFF) {
+                    result.decode_errors++;
+                    break;
+                }
+            }
+        }
+        okvs.SetSortedDecode(true);
+    }
+    result.encode_ms = Median(encode_times);
+    result.decode_ms = Median(decode_times);
+    result.unsorted_decode_ms = Median(unsorted_decode_times);
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    OkvsBenchOptions options = ParseOkvsBenchOptions(argc, argv);
+
+    ostringstream json;
+    json << "{\n  \"band_length\": " << options.band_length << ",\n  \"security\": " << options.security
+         << ",\n  \"trials\": " << options.trials << ",\n  \"threads\": " << omp_get_max_threads()
+         << ",\n  \"runs\": [\n";
+    bool first = true;
+    bool all_correct = true;
+    for (uint64_t n : options.sizes) {
+        for (OkvsType type : options.types) {
+            unique_ptr<OkvsBackend> okvs = MakeOkvsBackend(type, options.band_length);
+            uint64_t m = okvs->SizeFor(n, options.security);
+            OkvsRunResult r = RunOkvs(*okvs, n, m, options.trials);
+            all_correct = all_correct && r.decode_errors == 0;
+
+            cerr << okvs->Name() << " N = " << n << ": m = " << m << " (" << double(m) / n << "x), encode "
+                 << r.encode_ms << " ms, decode " << r.decode_ms << " ms (unsorted " << r.unsorted_decode_ms
+                 << " ms), failures " << r.failures << "/"
+                 << options.trials << endl;
+            if (!first) json << ",\n";
+            first = false;
+            json << "    {\"okvs\": \"" << okvs->Name() << "\", \"n\": " << n << ", \"m\": " << m
+                 << ", \"width\": " << okvs->Width() << ", \"expansion\": " << double(m) / n
+                 << ", \"encode_ms\": " << r.encode_ms << ", \"decode_ms\": " << r.decode_ms
+                 << ", \"unsorted_decode_ms\": " << r.unsorted_decode_ms
+                 << ", \"failure_log2\": " << okvs->FailureLog2(n, m) << ", \"failures\": " << r.failures
+                 << ", \"correct\": " << (r.decode_errors == 0 ? "true" : "false") << "}";
+        }
+    }
+    json << "\n  ]\n}\n";
+
+    if (options.output.empty()) {
+        cout << json.str();
+    } else {
+        ofstream(options.output) << json.str();
+    }
+    return all_correct ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+// BandOKVS参数选择与编码失败重试。
+// BandOKVS的编码失败概率由扩张率ε (m = (1+ε)n) 和band长度w决定，
+// 在固定ε下统计安全性近似为 λ ≈ a·w − b。下表给出各ε的拟合系数（取自BandOKVS论文的
+// 实验曲线并留有余量），选择满足目标λ且w不超过上限的最小ε，使OKVS（以及随之的VOLE长度和A'消息）最小。
+// 编码仍然失败时先更换键的盐值重新哈希，多次失败后再换用更大的ε。
+
+#include "sharded_okvs.hpp"
+#include <emmintrin.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <cstdint>
+#include <vector>
+
+struct OkvsEpsilonFit {
+    double epsilon;
+    double a;
+    double b;
+};
+
+// 按ε升序
+static constexpr OkvsEpsilonFit OKVS_EPSILON_FITS[] = {
+    {0.03, 0.0761, 5.7},
+    {0.05, 0.1091, 7.1},
+    {0.07, 0.1374, 6.8},
+    {0.10, 0.1756, 6.3},
+    {0.15, 0.2280, 5.9},
+    {0.27, 0.3200, 5.0},
+};
+static constexpr size_t OKVS_EPSILON_FIT_NUM = sizeof(OKVS_EPSILON_FITS) / sizeof(OKVS_EPSILON_FITS[0]);
+
+static constexpr uint64_t OKVS_BAND_ALIGN = 128;       // band按128位block存储
+static constexpr uint64_t OKVS_MAX_RESEEDS = 4;        // 每组参数下最多更换的盐值数
+
+struct OkvsParams {
+    uint64_t okvssize;
+    uint64_t band_length;
+    double epsilon;
+    size_t fit_index;   // 在OKVS_EPSILON_FITS中的位置，重试时从下一项开始
+};
+
+// 给定拟合系数和目标λ所需的band长度，按OKVS_BAND_ALIGN向上取整
+inline uint64_t BandLengthFor(const OkvsEpsilonFit& fit, uint64_t stat_security)
+{
+    uint64_t w = static_cast<uint64_t>(std::ceil((stat_security + fit.b) / fit.a));
+    return (w + OKVS_BAND_ALIGN - 1) / OKVS_BAND_ALIGN * OKVS_BAND_ALIGN;
+}
+
+// 分片OKVS的总长度：每个分片的输出段都要容纳最大分片的 (1+ε) 倍，并且长于band
+inline uint64_t OkvsSizeFor(double epsilon, uint64_t band_length, uint64_t max_shard_size, uint64_t shard_count)
+{
+    uint64_t shard_length = static_cast<uint64_t>(std::ceil((1.0 + epsilon) * max_shard_size));
+    shard_length = std::max(shard_length, max_shard_size + band_length);
+    return shard_length * shard_count;
+}
+
+// 从first_fit开始，选择w不超过max_band_length的最小ε；都不满足时取最后一项
+inline OkvsParams SelectOkvsParams(uint64_t max_shard_size, uint64_t shard_count, uint64_t stat_security,
+                                   uint64_t max_band_length, size_t first_fit = 0)
+{
+    size_t index = std::min(first_fit, OKVS_EPSILON_FIT_NUM - 1);
+    while (index + 1 < OKVS_EPSILON_FIT_NUM &&
+           BandLengthFor(OKVS_EPSILON_FITS[index], stat_security) > max_band_length) {
+        index++;
+    }
+    const OkvsEpsilonFit& fit = OKVS_EPSILON_FITS[index];
+    uint64_t band_length = BandLengthFor(fit, stat_security);
+    return {OkvsSizeFor(fit.epsilon, band_length, max_shard_size, shard_count), band_length, fit.epsilon, index};
+}
+
+// 盐值编号对应的盐值，0表示不加盐；双方由编号各自推出
+inline __m128i OkvsSalt(uint64_t salt_seed)
+{
+    if (salt_seed == 0) return _mm_setzero_si128();
+    return _mm_set_epi64x(static_cast<int64_t>(salt_seed * 0x9E3779B97F4A7C15ULL),
+                          static_cast<int64_t>(salt_seed * 0xC2B2AE3D27D4EB4FULL));
+}
+
+// 加盐后的OKVS键；盐值为0时返回空，调用方直接使用原始键
+inline std::vector<__m128i> SaltKeys(const std::vector<__m128i>& keys, uint64_t salt_seed)
+{
+    std::vector<__m128i> salted;
+    if (salt_seed == 0) return salted;
+    __m128i salt = OkvsSalt(salt_seed);
+    salted.resize(keys.size());
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < keys.size(); i++) {
+        salted[i] = _mm_xor_si128(keys[i], salt);
+    }
+    return salted;
+}
+
+// 编码结果：参数、盐值编号和OKVS向量P
+struct OkvsEncoding {
+    OkvsParams params;
+    uint64_t salt_seed = 0;
+    std::vector<__m128i> salted_keys;   // salt_seed为0时为空
+    std::vector<__m128i> output;
+    uint64_t attempts = 0;
+};
+
+// 编码 {key_i -> value_i}，键为加盐后的elems，值为elems本身。
+// initial为空指针时自动选择参数；失败时依次更换盐值、增大ε，全部失败返回false。
+inline bool EncodeWithRetry(std::vector<__m128i>& elems, uint64_t shard_count, uint64_t stat_security,
+                            uint64_t max_band_length, const OkvsParams* initial, OkvsEncoding& enc)
+{
+    size_t next_fit = 0;
+    bool use_initial = initial != nullptr;
+    while (true) {
+        for (uint64_t salt_seed = 0; salt_seed < OKVS_MAX_RESEEDS; salt_seed++) {
+            enc.salt_seed = salt_seed;
+            enc.salted_keys = SaltKeys(elems, salt_seed);
+            std::vector<__m128i>& keys = salt_seed == 0 ? elems : enc.salted_keys;
+
+            // 各分片按公开的容量编码，参数只取决于n和分片数
+            uint64_t capacity = ShardedBandOkvs::ShardCapacity(elems.size(), shard_count);
+            if (use_initial) {
+                enc.params = *initial;
+            } else {
+                enc.params = SelectOkvsParams(capacity, shard_count, stat_security, max_band_length, next_fit);
+            }
+
+            ShardedBandOkvs okvs;
+            okvs.Init(elems.size(), shard_count, enc.params.okvssize, enc.params.band_length);
+            enc.output.assign(enc.params.okvssize, _mm_setzero_si128());
+            enc.attempts++;
+            if (okvs.Encode(keys.data(), elems.data(), enc.output.data(), elems.size())) {
+                return true;
+            }
+            std::cerr << "OKVS encoding failed (m = " << enc.params.okvssize << ", w = "
+                      << enc.params.band_length << ", salt " << salt_seed << "), retrying" << std::endl;
+        }
+
+        // 当前参数下多次失败，换用更大的ε
+        next_fit = use_initial ? 0 : enc.params.fit_index + 1;
+        if (use_initial) {
+            // 从比指定扩张率更大的第一项开始自动选择
+            while (next_fit < OKVS_EPSILON_FIT_NUM && OKVS_EPSILON_FITS[next_fit].epsilon <= initial->epsilon) {
+                next_fit++;
+            }
+            use_initial = false;
+        }
+        if (next_fit >= OKVS_EPSILON_FIT_NUM) {
+            return false;
+        }
+        max_band_length = std::max<uint64_t>(max_band_length, BandLengthFor(OKVS_EPSILON_FITS[next_fit], stat_security));
+    }
+}
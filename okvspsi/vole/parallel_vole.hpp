@@ -0,0 +1,122 @@
+#pragma once
+
+// 多通道并行VOLE：把n个相关性按下标均分给T个通道，每个通道一个独立的NetIO（端口依次为 port, port+1, ...）
+// 并在自己的线程中运行Kunlun VOLE，输出按通道顺序拼接到调用方的向量中。
+// 发送方所有通道使用同一个Δ，各通道的片段都满足 B = C ⊕ Δ·A，拼接后仍是一段长度为n的VOLE相关性。
+// 双方按n和通道数得到相同的切分；通道数在建立时核对，不一致时双方都无法继续。
+
+#include "fastpsi.hpp"
+#include <omp.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ParallelVoleBackend : public VoleBackend {
+public:
+    // 每个通道至少这么多相关性，小实例不值得为每个通道重复基础OT
+    static constexpr uint64_t MIN_CORRELATIONS_PER_CHANNEL = 1 << 16;
+
+    // ios为专用于VOLE的各通道连接，与协议消息的NetIO相互独立；fixed_delta的含义与KunlunVoleBackend相同
+    ParallelVoleBackend(std::vector<NetIO*> ios, uint64_t t, const block* fixed_delta = nullptr)
+        : ios_(std::move(ios)), t_(t), fixed_delta_(fixed_delta)
+    {
+        uint64_t mine = ios_.size(), peer = 0;
+        ios_[0]->SendBytes(&mine, sizeof(mine));
+        ios_[0]->ReceiveBytes(&peer, sizeof(peer));
+        if (peer != mine) {
+            std::cerr << "VOLE channel count mismatch: " << mine << " vs " << peer << std::endl;
+            exit(1);
+        }
+    }
+
+    // 各通道都是Kunlun VOLE，相关性和域表示与KunlunVoleBackend相同，通道数不影响MulXor，
+    // 因此用同一名称：并行生成的离线池可由单通道的在线后端使用
+    const char* Name() const override { return "kunlun"; }
+
+    void Receive(uint64_t n, std::vector<block>& vec_A, std::vector<block>& vec_C) override
+    {
+        vec_A.resize(n);
+        vec_C.resize(n);
+        RunChannels(n, [&](size_t ch, uint64_t begin, uint64_t len) {
+            std::vector<block> c;
+            std::vector<block> a = VOLE::VOLE_A(*ios_[ch], len, c, t_);
+            std::memcpy(vec_A.data() + begin, a.data(), len * sizeof(block));
+            std::memcpy(vec_C.data() + begin, c.data(), len * sizeof(block));
+        });
+    }
+
+    void Send(uint64_t n, block& delta, std::vector<block>& vec_B) override
+    {
+        if (fixed_delta_ != nullptr) {
+            delta = *fixed_delta_;
+        } else {
+            PRG::Seed seed = PRG::SetSeed();
+            delta = PRG::GenRandomBlocks(seed, 1)[0];
+        }
+        vec_B.resize(n);
+        RunChannels(n, [&](size_t ch, uint64_t begin, uint64_t len) {
+            std::vector<block> b;
+            VOLE::VOLE_B(*ios_[ch], len, b, delta, t_);
+            std::memcpy(vec_B.data() + begin, b.data(), len * sizeof(block));
+        });
+    }
+
+    void MulXor(const block& delta, const block* in, block* inout, size_t n) const override
+    {
+        gf128_mul_xor_batch(delta, in, inout, n);
+    }
+
+    // n个相关性实际使用的通道数
+    size_t ChannelsFor(uint64_t n) const
+    {
+        return std::clamp<uint64_t>(n / MIN_CORRELATIONS_PER_CHANNEL, 1, ios_.size());
+    }
+
+private:
+    // 第ch个通道负责 [ch·n/T, (ch+1)·n/T)；OpenMP线程平分给各通道
+    template <typename RunChannel>
+    void RunChannels(uint64_t n, RunChannel&& run_channel)
+    {
+        size_t channels = ChannelsFor(n);
+        if (channels == 1) {
+            run_channel(0, 0, n);
+            return;
+        }
+        int threads_per_channel = std::max<int>(1, omp_get_max_threads() / int(channels));
+        std::vector<std::thread> workers;
+        for (size_t ch = 0; ch < channels; ch++) {
+            workers.emplace_back([&, ch]() {
+                omp_set_num_threads(threads_per_channel);
+                uint64_t begin = n * ch / channels, end = n * (ch + 1) / channels;
+                run_channel(ch, begin, end - begin);
+            });
+        }
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    std::vector<NetIO*> ios_;
+    uint64_t t_;
+    const block* fixed_delta_;
+};
+
+// 建立VOLE专用的各通道连接，端口依次为 first_port, first_port+1, ...；双方按相同顺序建立
+inline std::vector<std::unique_ptr<NetIO>> OpenVoleChannels(const std::string& party, const std::string& address,
+                                                            uint16_t first_port, size_t channels)
+{
+    std::vector<std::unique_ptr<NetIO>> ios;
+    for (size_t ch = 0; ch < channels; ch++) {
+        ios.push_back(std::make_unique<NetIO>(party, address, uint16_t(first_port + ch)));
+    }
+    return ios;
+}
+
+inline std::vector<NetIO*> ChannelPointers(const std::vector<std::unique_ptr<NetIO>>& ios)
+{
+    std::vector<NetIO*> pointers;
+    for (const std::unique_ptr<NetIO>& io : ios) pointers.push_back(io.get());
+    return pointers;
+}
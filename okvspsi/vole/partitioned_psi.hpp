@@ -0,0 +1,288 @@
+#pragma once
+
+// 分桶FastPSI：双方用共享密钥的AES把元素哈希到K个桶，逐桶运行互相独立的小规模FastPSI。
+// 相同元素必然落入同一个桶，各桶交集的并即为整体交集；每个实例的OKVS、VOLE和masks缓冲区
+// 只与桶大小成正比，峰值内存由桶大小和同时运行的桶数决定，而不是整个集合。
+// 同时运行的桶数等于通道数：每个通道是一对独立的NetIO/VoleBackend，第b个桶固定由第 b mod L 个通道处理，
+// 双方无需额外协调即按相同顺序运行。桶的分配密钥由接收方随机选取并告知发送方。
+// 双方都知道分配密钥，若公开各桶的实际大小，对方就能从空桶或小桶推断某个候选元素不在集合中；
+// 因此每个桶都用随机元素填充到由集合大小和桶数决定的公开容量 BinCapacity(n, K, PARTITION_OVERFLOW_SECURITY)，
+// 握手中只交换n和双方的分桶设置，与普通FastPSI一样只泄露集合大小。代价是每个桶多出的余量，K越大占比越高；
+// 某个桶超出容量（概率不超过 2^-PARTITION_OVERFLOW_SECURITY）时放弃本次运行。
+
+#include "fastpsi.hpp"
+#include "fixed_key_aes.hpp"
+#include <algorithm>
+#include <climits>
+#include <random>
+#include <thread>
+#include <vector>
+
+// 每个元素在一次FastPSI实例中的峰值内存估计（字节）：
+// 元素副本、加盐键、OKVS输出、VOLE的A/C（或B/A'）、masks，以及编码时的band矩阵行
+static constexpr uint64_t PARTITION_BYTES_PER_ITEM = 256;
+// 任一桶超出公开容量的概率不超过 2^-PARTITION_OVERFLOW_SECURITY
+static constexpr uint64_t PARTITION_OVERFLOW_SECURITY = 40;
+
+struct PartitionParams {
+    uint64_t partitions = 0;        // 桶数，0表示按内存预算选择
+    uint64_t memory_budget = 0;     // 所有通道合计的内存预算（字节），0表示不限制
+};
+
+// 一个通道：协议消息和VOLE相关性的来源
+struct PsiLane {
+    NetIO* io;
+    VoleBackend* vole;
+};
+
+// 双方交换的分桶参数。桶数要等双方集合大小都已知后才能确定，因此交换的是各自的设置，
+// 各桶的容量由set_size和最终的桶数推出
+struct PartitionHello {
+    uint64_t set_size;
+    uint64_t partitions;    // 本方指定的桶数，0表示按内存预算选择
+    uint64_t memory_budget;
+    uint64_t lanes;
+    block key;              // 桶分配密钥，仅接收方的有效
+};
+
+// 一方设置所要求的桶数。max_size为双方集合大小的较大值：本方的桶填充到自己的容量，
+// 而FastPSI实例的部分缓冲区（如发送方的masks比较、接收方的OKVS解码）按对方的容量分配。
+// 在预算下选最小的K，使L个通道同时运行时 BinCapacity(max_size, K) · 每元素内存 不超过 预算 / L；
+// 返回0表示预算过小，任何桶数都无法满足
+inline uint64_t PartitionsFor(uint64_t max_size, uint64_t lanes, uint64_t partitions, uint64_t memory_budget)
+{
+    if (partitions != 0) return partitions;
+    if (memory_budget == 0 || max_size == 0) return 1;
+    uint64_t per_lane_items = memory_budget / lanes / PARTITION_BYTES_PER_ITEM;
+    auto fits = [&](uint64_t k) {
+        return BinCapacity(max_size, k, PARTITION_OVERFLOW_SECURITY) <= per_lane_items;
+    };
+    // 容量不小于 ceil(n/K)，由此得到K的下界；再倍增找到可行的K，在最后一段内二分
+    uint64_t limit = std::min<uint64_t>(max_size, UINT32_MAX);
+    uint64_t lo = per_lane_items == 0 ? limit : std::min(limit, (max_size + per_lane_items - 1) / per_lane_items);
+    lo = std::max<uint64_t>(1, lo);
+    if (fits(lo)) return lo;
+    uint64_t hi = lo;
+    while (hi < limit && !fits(hi)) {
+        lo = hi;
+        hi = std::min(limit, hi * 2);
+    }
+    if (!fits(hi)) return 0;
+    while (hi - lo > 1) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (fits(mid)) hi = mid;
+        else lo = mid;
+    }
+    return hi;
+}
+
+// 元素按桶排列的下标：第b个桶为 order[offsets[b], offsets[b+1])
+struct Partition {
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> order;
+
+    uint64_t Size(uint64_t b) const { return offsets[b + 1] - offsets[b]; }
+};
+
+// 桶号 = AES_key(x)低64位乘以K取高64位；按块并行计算桶号，再计数排序
+inline void PartitionItems(const std::vector<block>& items, const block& key, uint64_t partitions, Partition& out)
+{
+    static constexpr size_t CHUNK_SIZE = 1 << 14;
+    FixedKeyAES aes(key);
+    std::vector<uint32_t> bucket_of(items.size());
+    size_t chunk_num = (items.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    #pragma omp parallel for schedule(static)
+    for (size_t c = 0; c < chunk_num; c++) {
+        size_t end = std::min<size_t>((c + 1) * CHUNK_SIZE, items.size());
+        for (size_t i = c * CHUNK_SIZE; i < end; i++) {
+            uint64_t h = _mm_cvtsi128_si64(aes.Encrypt(items[i]));
+            bucket_of[i] = uint32_t((unsigned __int128)h * partitions >> 64);
+        }
+    }
+
+    out.offsets.assign(partitions + 1, 0);
+    for (uint32_t b : bucket_of) out.offsets[b + 1]++;
+    for (uint64_t b = 0; b < partitions; b++) out.offsets[b + 1] += out.offsets[b];
+    out.order.resize(items.size());
+    std::vector<uint64_t> cursor(out.offsets.begin(), out.offsets.end() - 1);
+    for (size_t i = 0; i < items.size(); i++) out.order[cursor[bucket_of[i]]++] = uint32_t(i);
+}
+
+// 取出第b个桶的元素，并用随机元素填充到capacity个。填充元素由本地真随机种子生成，
+// 与对方元素（包括对方的填充元素）相同的概率可忽略
+inline void GatherBucket(const std::vector<block>& items, const Partition& partition, uint64_t b,
+                         uint64_t capacity, std::vector<block>& bucket)
+{
+    uint64_t size = partition.Size(b);
+    bucket.resize(capacity);
+    for (uint64_t j = 0; j < size; j++) {
+        bucket[j] = items[partition.order[partition.offsets[b] + j]];
+    }
+    if (size < capacity) {
+        std::random_device rd;
+        std::mt19937_64 rng((uint64_t(rd()) << 32) ^ rd());
+        for (uint64_t j = size; j < capacity; j++) bucket[j] = _mm_set_epi64x(int64_t(rng()), int64_t(rng()));
+    }
+}
+
+// 双方交换PartitionHello，确定桶数和分桶结果；my_capacity和peer_capacity为双方各桶的公开容量。
+// 返回false表示参数不一致或本方某个桶超出容量
+inline bool SetupPartition(PsiLane& lane, const std::vector<block>& items, uint64_t lanes,
+                           const PartitionParams& params, bool receiver, Partition& partition,
+                           uint64_t& my_capacity, uint64_t& peer_capacity)
+{
+    if (items.size() > UINT32_MAX) {
+        std::cerr << "Partitioned PSI supports at most 2^32-1 elements per party" << std::endl;
+        return false;
+    }
+    PartitionHello mine{items.size(), params.partitions, params.memory_budget, lanes, _mm_setzero_si128()};
+    PartitionHello peer;
+    if (receiver) {
+        PRG::Seed seed = PRG::SetSeed();
+        mine.key = PRG::GenRandomBlocks(seed, 1)[0];
+        lane.io->SendBytes(&mine, sizeof(mine));
+        lane.io->ReceiveBytes(&peer, sizeof(peer));
+    } else {
+        lane.io->ReceiveBytes(&peer, sizeof(peer));
+        lane.io->SendBytes(&mine, sizeof(mine));
+    }
+    if (peer.lanes != lanes) {
+        std::cerr << "Partitioned PSI lane count mismatch: " << lanes << " vs " << peer.lanes << std::endl;
+        return false;
+    }
+    if (peer.set_size > MAX_PEER_SET_SIZE) {
+        std::cerr << "Invalid peer set size: " << peer.set_size << std::endl;
+        return false;
+    }
+    // 双方由相同的输入算出相同的桶数，取两方要求的较大值
+    uint64_t max_size = std::max<uint64_t>(items.size(), peer.set_size);
+    uint64_t my_partitions = PartitionsFor(max_size, lanes, mine.partitions, mine.memory_budget);
+    uint64_t peer_partitions = PartitionsFor(max_size, lanes, peer.partitions, peer.memory_budget);
+    if (my_partitions == 0 || peer_partitions == 0) {
+        std::cerr << "Memory budget too small for " << max_size << " items over " << lanes << " lanes" << std::endl;
+        return false;
+    }
+    uint64_t partitions = std::max(my_partitions, peer_partitions);
+    if (partitions > UINT32_MAX) {
+        std::cerr << "Invalid partition count: " << partitions << std::endl;
+        return false;
+    }
+    PartitionItems(items, receiver ? mine.key : peer.key, partitions, partition);
+
+    my_capacity = BinCapacity(items.size(), partitions, PARTITION_OVERFLOW_SECURITY);
+    peer_capacity = BinCapacity(peer.set_size, partitions, PARTITION_OVERFLOW_SECURITY);
+    for (uint64_t b = 0; b < partitions; b++) {
+        if (partition.Size(b) > my_capacity) {
+            std::cerr << "Partition bucket " << b << " exceeds its capacity " << my_capacity << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// 每个通道在自己的线程中依次处理分配给它的桶，并把OpenMP线程平分给各通道
+template <typename RunBucket>
+void RunLanes(std::vector<PsiLane>& lanes, uint64_t partitions, RunBucket&& run_bucket)
+{
+    int threads_per_lane = std::max<int>(1, omp_get_max_threads() / int(lanes.size()));
+    auto lane_main = [&](size_t l) {
+        omp_set_num_threads(threads_per_lane);
+        for (uint64_t b = l; b < partitions; b += lanes.size()) run_bucket(l, b);
+    };
+    if (lanes.size() == 1) {
+        lane_main(0);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (size_t l = 0; l < lanes.size(); l++) workers.emplace_back(lane_main, l);
+    for (std::thread& worker : workers) worker.join();
+}
+
+// 各桶FastPSI的mask长度。桶内按公开容量自动选择会让误判概率只对单个桶成立，
+// K个桶共比较 K·C_s·C_r 对（含填充元素），因此λ再加上log2 K
+inline uint64_t BucketMaskBytes(const FastPSIParams& params, uint64_t partitions,
+                                uint64_t sender_capacity, uint64_t receiver_capacity)
+{
+    if (params.mask_bytes != 0) return params.mask_bytes;
+    return MaskBytesFor(sender_capacity, receiver_capacity, params.stat_security + CeilLog2(partitions));
+}
+
+inline void AddPhaseTimes(FastPSIPhaseTimes& total, const FastPSIPhaseTimes& t)
+{
+    total.okvs_encode += t.okvs_encode;
+    total.vole += t.vole;
+    total.a_prime += t.a_prime;
+    total.okvs_decode += t.okvs_decode;
+    total.masks += t.masks;
+    total.intersect += t.intersect;
+}
+
+// 分桶FastPSI接收方，lanes[0]同时用于交换分桶参数；返回交集元素（按桶顺序）
+inline std::vector<block> PartitionedPsiRecv(std::vector<PsiLane>& lanes, std::vector<block>& elem_hashes,
+                                             const FastPSIParams& params, const PartitionParams& partition_params,
+                                             FastPSIPhaseTimes* times = nullptr)
+{
+    Partition partition;
+    uint64_t capacity = 0, sender_capacity = 0;
+    if (!SetupPartition(lanes[0], elem_hashes, lanes.size(), partition_params, true, partition,
+                        capacity, sender_capacity)) {
+        exit(1);
+    }
+    uint64_t partitions = partition.offsets.size() - 1;
+    if (params.verbose) std::cout << "Partitioned PSI: " << partitions << " buckets of " << capacity
+                                  << " items over " << lanes.size() << " lanes" << std::endl;
+
+    std::vector<std::vector<block>> bucket_results(partitions);
+    std::vector<FastPSIPhaseTimes> lane_times(lanes.size());
+    FastPSIParams bucket_params = params;
+    bucket_params.verbose = false;
+    bucket_params.mask_bytes = BucketMaskBytes(params, partitions, sender_capacity, capacity);
+    RunLanes(lanes, partitions, [&](size_t l, uint64_t b) {
+        // 容量为0只在一方集合为空时出现，双方都能判断
+        if (capacity == 0 || sender_capacity == 0) return;
+        std::vector<block> bucket;
+        GatherBucket(elem_hashes, partition, b, capacity, bucket);
+        // 指定的OKVS大小按桶大小等比例缩放
+        FastPSIParams lane_params = bucket_params;
+        if (params.okvssize != 0) {
+            lane_params.okvssize = (params.okvssize * bucket.size() + elem_hashes.size() - 1) / elem_hashes.size();
+        }
+        bucket_results[b] = FastPsiRecv(*lanes[l].io, *lanes[l].vole, bucket, lane_params, &lane_times[l]);
+    });
+
+    std::vector<block> intersection;
+    for (std::vector<block>& r : bucket_results) intersection.insert(intersection.end(), r.begin(), r.end());
+    if (times != nullptr) {
+        for (const FastPSIPhaseTimes& t : lane_times) AddPhaseTimes(*times, t);
+    }
+    return intersection;
+}
+
+// 分桶FastPSI发送方
+inline void PartitionedPsiSend(std::vector<PsiLane>& lanes, std::vector<block>& elem_hashes,
+                               const FastPSIParams& params, const PartitionParams& partition_params,
+                               FastPSIPhaseTimes* times = nullptr)
+{
+    Partition partition;
+    uint64_t capacity = 0, receiver_capacity = 0;
+    if (!SetupPartition(lanes[0], elem_hashes, lanes.size(), partition_params, false, partition,
+                        capacity, receiver_capacity)) {
+        exit(1);
+    }
+    uint64_t partitions = partition.offsets.size() - 1;
+
+    std::vector<FastPSIPhaseTimes> lane_times(lanes.size());
+    FastPSIParams bucket_params = params;
+    bucket_params.verbose = false;
+    bucket_params.mask_bytes = BucketMaskBytes(params, partitions, capacity, receiver_capacity);
+    RunLanes(lanes, partitions, [&](size_t l, uint64_t b) {
+        if (capacity == 0 || receiver_capacity == 0) return;
+        std::vector<block> bucket;
+        GatherBucket(elem_hashes, partition, b, capacity, bucket);
+        FastPsiSend(*lanes[l].io, *lanes[l].vole, bucket, bucket_params, &lane_times[l]);
+    });
+
+    if (times != nullptr) {
+        for (const FastPSIPhaseTimes& t : lane_times) AddPhaseTimes(*times, t);
+    }
+}
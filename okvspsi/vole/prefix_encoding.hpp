@@ -0,0 +1,108 @@
+#pragma once
+
+// 距离阈值模糊匹配的前缀编码（与APSI__Test/src/prefixencode.cpp的编码一致）：
+// 接收方把邻域 [x-δ, x+δ] 分解为互不相交的二进制前缀，发送方为y生成末尾0..w位为通配符的全部前缀，
+// w = ⌊log2(2δ-1)⌋+1。|x-y| ≤ δ 当且仅当双方恰有一个前缀相同，模糊匹配因此化为前缀集合的精确求交。
+// 前缀以 (value, wildcards) 表示，value为去掉通配位后的高位；求交时经hash_to_block.hpp的MMO哈希映射为block。
+
+#include "../mpc/vole/vole.hpp"
+#include "hash_to_block.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static constexpr int IP_BIT_LENGTH = 32;
+
+struct IpPrefix {
+    uint32_t value;      // ip >> wildcards
+    uint32_t wildcards;  // 末尾通配位数
+
+    uint64_t Key() const { return (uint64_t(wildcards) << IP_BIT_LENGTH) | value; }
+
+    // 前缀覆盖的区间 [Low(), High()]
+    uint32_t Low() const { return wildcards >= IP_BIT_LENGTH ? 0 : value << wildcards; }
+    uint32_t High() const { return Low() | uint32_t((uint64_t(1) << wildcards) - 1); }
+};
+
+// APSI编码使用的字符串形式，例如 "1110**"（32位，'*'为通配位）
+inline std::string PrefixToString(const IpPrefix& prefix)
+{
+    std::string result(IP_BIT_LENGTH, '*');
+    for (int i = 0; i < IP_BIT_LENGTH - int(prefix.wildcards); i++) {
+        result[i] = '0' + ((prefix.value >> (IP_BIT_LENGTH - prefix.wildcards - 1 - i)) & 1);
+    }
+    return result;
+}
+
+inline uint32_t Ipv4ToUint32(const std::string& ip_str)
+{
+    std::istringstream iss(ip_str);
+    std::string token;
+    uint32_t ip = 0;
+    int shift = 24;
+    while (std::getline(iss, token, '.') && shift >= 0) {
+        ip |= uint32_t(std::stoul(token)) << shift;
+        shift -= 8;
+    }
+    return ip;
+}
+
+inline std::string Uint32ToIpv4(uint32_t ip)
+{
+    return std::to_string(ip >> 24) + "." + std::to_string((ip >> 16) & 0xFF) + "."
+         + std::to_string((ip >> 8) & 0xFF) + "." + std::to_string(ip & 0xFF);
+}
+
+// 发送方通配位数 w = ⌊log2(2δ-1)⌋+1，覆盖邻域分解中最长的前缀（块长不超过2δ+1）
+inline uint32_t WildcardBitsFor(uint64_t delta)
+{
+    return delta == 0 ? 0 : uint32_t(std::bit_width(2 * delta - 1));
+}
+
+// 接收方编码：邻域 [ip-δ, ip+δ]（截断到32位范围）的最小二进制前缀分解
+inline void EncodeReceiverPrefixes(uint32_t ip, uint64_t delta, std::vector<IpPrefix>& out)
+{
+    uint64_t left = ip >= delta ? ip - delta : 0;
+    uint64_t right = std::min<uint64_t>(UINT32_MAX, uint64_t(ip) + delta);
+    while (left <= right) {
+        // 以left对齐且不越过right的最大块
+        uint32_t k = 0;
+        while (k < IP_BIT_LENGTH && (left & ((uint64_t(1) << (k + 1)) - 1)) == 0
+               && left + (uint64_t(1) << (k + 1)) - 1 <= right) {
+            k++;
+        }
+        out.push_back({uint32_t(left >> k), k});
+        left += uint64_t(1) << k;
+    }
+}
+
+// 发送方编码：从最具体到最通用的通配符前缀，例如 111000 -> 111000, 11100*, 1110**, 111***
+inline void EncodeSenderPrefixes(uint32_t ip, uint32_t wildcard_bits, std::vector<IpPrefix>& out)
+{
+    for (uint32_t w = 0; w <= wildcard_bits && w < IP_BIT_LENGTH; w++) {
+        out.push_back({ip >> w, w});
+    }
+}
+
+inline std::vector<IpPrefix> EncodeReceiverPrefixes(uint32_t ip, uint64_t delta)
+{
+    std::vector<IpPrefix> prefixes;
+    EncodeReceiverPrefixes(ip, delta, prefixes);
+    return prefixes;
+}
+
+inline std::vector<IpPrefix> EncodeSenderPrefixes(uint32_t ip, uint32_t wildcard_bits)
+{
+    std::vector<IpPrefix> prefixes;
+    EncodeSenderPrefixes(ip, wildcard_bits, prefixes);
+    return prefixes;
+}
+
+// 前缀键到PSI元素，前缀键各不相同，128位输出上的碰撞概率可忽略
+inline void PrefixKeysToBlocks(const uint64_t* keys, block* out, size_t n)
+{
+    HashUint64ToBlocks(keys, out, n);
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+// 分片BandOKVS：按键的哈希把N个键划分到T个独立的子OKVS，
+// 每个子OKVS占用输出向量中固定的一段 [s·m/T, (s+1)·m/T)，编码和解码按分片并行。
+// 分片哈希不带密钥，若公开各分片的实际键数，就会泄露接收方集合在分片上的分布。
+// 因此每个分片固定编码 ShardCapacity(n, T) 个键（⌈n/T⌉ 加上溢出概率不超过 2^-SHARD_OVERFLOW_SECURITY
+// 的余量），不足部分用随机键值对填充，握手中只传递n和T；某个分片超出容量时编码失败，由调用方换盐重试。
+// T = 1 时不填充，与直接使用 BandOkvs 完全相同。
+
+#include "bandokvs/band_okvs.h"
+#include "block_view.hpp"
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// n个元素均匀哈希到bins个桶时的公开桶容量：任一桶超出的概率不超过 2^-security。
+// 桶大小X ~ Binomial(n, 1/bins)，均值μ = n/bins，由Bernstein不等式
+// Pr[X ≥ μ + t] ≤ exp(−t² / (2(μ + t/3)))，对所有桶取并集界，令 L = (security + log2 bins)·ln2，
+// 取 t = L/3 + sqrt(L²/9 + 2Lμ)
+inline uint64_t BinCapacity(uint64_t n, uint64_t bins, uint64_t security)
+{
+    if (bins <= 1) return n;
+    double mean = double(n) / bins;
+    double l = (security + std::log2(double(bins))) * std::log(2.0);
+    double slack = l / 3 + std::sqrt(l * l / 9 + 2 * l * mean);
+    return std::min<uint64_t>(n, (n + bins - 1) / bins + uint64_t(std::ceil(slack)));
+}
+
+class ShardedBandOkvs {
+public:
+    // 每个分片至少这么多键，保证每个子OKVS的规模足以维持BandOKVS的扩张率
+    static constexpr uint64_t MIN_KEYS_PER_SHARD = 1 << 16;
+    // 任一分片超出容量的概率不超过 2^-SHARD_OVERFLOW_SECURITY
+    static constexpr uint64_t SHARD_OVERFLOW_SECURITY = 40;
+
+    // 根据集合大小和线程数选择分片数；只有n和分片数会发送给对方
+    static uint64_t AutoShardCount(uint64_t n, uint64_t threads)
+    {
+        return std::max<uint64_t>(1, std::min<uint64_t>(threads, n / MIN_KEYS_PER_SHARD));
+    }
+
+    // 每个分片编码的键数
+    static uint64_t ShardCapacity(uint64_t n, uint64_t shard_count)
+    {
+        return BinCapacity(n, shard_count, SHARD_OVERFLOW_SECURITY);
+    }
+
+    // 键所属的分片，与BandOkvs内部的哈希相互独立
+    static uint64_t ShardOf(const __m128i& key, uint64_t shard_count)
+    {
+        uint64_t lo = static_cast<uint64_t>(_mm_cvtsi128_si64(key));
+        uint64_t hi = static_cast<uint64_t>(_mm_extract_epi64(key, 1));
+        uint64_t h = (hi ^ ((lo << 29) | (lo >> 35))) * 0xD6E8FEB86659FD93ULL;
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(h ^ (h >> 32)) * shard_count) >> 64);
+    }
+
+    // 统计每个分片的键数，并得到按分片分组的下标顺序（分片内保持原顺序）
+    static std::vector<uint64_t> Partition(const __m128i* keys, uint64_t n, uint64_t shard_count,
+                                           std::vector<uint64_t>& order)
+    {
+        std::vector<uint32_t> shard_of(n);
+        #pragma omp parallel for schedule(static)
+        for (uint64_t i = 0; i < n; i++) {
+            shard_of[i] = static_cast<uint32_t>(ShardOf(keys[i], shard_count));
+        }
+
+        std::vector<uint64_t> shard_sizes(shard_count, 0);
+        for (uint64_t i = 0; i < n; i++) {
+            shard_sizes[shard_of[i]]++;
+        }
+        std::vector<uint64_t> cursor(shard_count, 0);
+        for (uint64_t s = 1; s < shard_count; s++) {
+            cursor[s] = cursor[s - 1] + shard_sizes[s - 1];
+        }
+        order.resize(n);
+        for (uint64_t i = 0; i < n; i++) {
+            order[cursor[shard_of[i]]++] = i;
+        }
+        return shard_sizes;
+    }
+
+    // n 为编码方的键数，m 为总输出长度，w 为band长度
+    void Init(uint64_t n, uint64_t shard_count, uint64_t m, uint64_t w)
+    {
+        shard_count_ = std::max<uint64_t>(1, shard_count);
+        capacity_ = ShardCapacity(n, shard_count_);
+        m_ = m;
+        w_ = w;
+    }
+
+    uint64_t ShardCount() const { return shard_count_; }
+    uint64_t Capacity() const { return capacity_; }
+
+    // 分片s在输出向量中的起始位置和长度
+    uint64_t ShardBegin(uint64_t s) const { return s * m_ / ShardCount(); }
+    uint64_t ShardLength(uint64_t s) const { return ShardBegin(s + 1) - ShardBegin(s); }
+
+    // 编码n个键值对，out长度为m；任一分片超出容量或编码失败则返回false
+    bool Encode(__m128i* keys, __m128i* values, __m128i* out, uint64_t n) const
+    {
+        uint64_t shard_count = ShardCount();
+        if (shard_count == 1) {
+            band_okvs::BandOkvs okvs;
+            okvs.Init(n, m_, w_);
+            return okvs.Encode(ToOc(keys), ToOc(values), ToOc(out));
+        }
+
+        std::vector<uint64_t> order;
+        std::vector<uint64_t> sizes = Partition(keys, n, shard_count, order);
+        if (*std::max_element(sizes.begin(), sizes.end()) > capacity_) return false;
+        std::vector<uint64_t> offsets(shard_count, 0);
+        for (uint64_t s = 1; s < shard_count; s++) {
+            offsets[s] = offsets[s - 1] + sizes[s - 1];
+        }
+
+        std::random_device rd;
+        uint64_t seed = (uint64_t(rd()) << 32) ^ rd();
+        bool success = true;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(&& : success)
+        for (uint64_t s = 0; s < shard_count; s++) {
+            std::vector<__m128i> shard_keys(capacity_);
+            std::vector<__m128i> shard_values(capacity_);
+            for (uint64_t j = 0; j < sizes[s]; j++) {
+                shard_keys[j] = keys[order[offsets[s] + j]];
+                shard_values[j] = values[order[offsets[s] + j]];
+            }
+            // 随机填充到容量，随机键与真实键碰撞的概率可忽略
+            std::mt19937_64 rng(seed + s);
+            for (uint64_t j = sizes[s]; j < capacity_; j++) {
+                shard_keys[j] = _mm_set_epi64x(int64_t(rng()), int64_t(rng()));
+                shard_values[j] = _mm_set_epi64x(int64_t(rng()), int64_t(rng()));
+            }
+            band_okvs::BandOkvs okvs;
+            okvs.Init(capacity_, ShardLength(s), w_);
+            success = okvs.Encode(AsOcBlocks(shard_keys).data(), AsOcBlocks(shard_values).data(),
+                                  ToOc(out + ShardBegin(s))) && success;
+        }
+        return success;
+    }
+
+    // 解码n个键，in为长度m的OKVS向量，结果按keys的顺序写入out
+    void Decode(__m128i* keys, __m128i* in, __m128i* out, uint64_t n) const
+    {
+        uint64_t shard_count = ShardCount();
+        if (shard_count == 1) {
+            band_okvs::BandOkvs okvs;
+            okvs.Init(capacity_, m_, w_);
+            okvs.Decode(ToOc(keys), ToOc(in), ToOc(out), n);
+            return;
+        }
+
+        std::vector<uint64_t> order;
+        std::vector<uint64_t> sizes = Partition(keys, n, shard_count, order);
+
+        std::vector<uint64_t> offsets(shard_count, 0);
+        for (uint64_t s = 1; s < shard_count; s++) {
+            offsets[s] = offsets[s - 1] + sizes[s - 1];
+        }
+
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (uint64_t s = 0; s < shard_count; s++) {
+            std::vector<__m128i> shard_keys(sizes[s]);
+            std::vector<__m128i> shard_out(sizes[s]);
+            for (uint64_t j = 0; j < sizes[s]; j++) {
+                shard_keys[j] = keys[order[offsets[s] + j]];
+            }
+            band_okvs::BandOkvs okvs;
+            okvs.Init(capacity_, ShardLength(s), w_);
+            okvs.Decode(AsOcBlocks(shard_keys).data(), ToOc(in + ShardBegin(s)),
+                        AsOcBlocks(shard_out).data(), sizes[s]);
+            for (uint64_t j = 0; j < sizes[s]; j++) {
+                out[order[offsets[s] + j]] = shard_out[j];
+            }
+        }
+    }
+
+private:
+    static oc::block* ToOc(__m128i* p) { return reinterpret_cast<oc::block*>(p); }
+
+    uint64_t shard_count_ = 1;
+    uint64_t capacity_ = 0;
+    uint64_t m_ = 0;
+    uint64_t w_ = 0;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+// 按位置排序的分块OKVS解码。键按输入顺序解码时，每个键读取OKVS向量中一个随机位置的窗口，
+// 向量有数MB时几乎每次都是缓存未命中。这里先按键的首个列位置做基数分桶（桶内不再排序），
+// 再按桶顺序把键分成小块：每块先生成各行，求值时提前预取后面几行的起始列，结果写回原下标。
+// 每个线程处理连续的块，因而只访问向量中相邻的一段。
+
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#include <omp.h>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// OKVS向量小于此值时基本留在末级缓存中，排序的代价超过收益，直接按输入顺序解码
+static constexpr uint64_t SORTED_DECODE_MIN_BYTES = 16 << 20;
+// 每个桶覆盖的列数（4KB），只需比一块键跨越的范围小
+static constexpr uint64_t DECODE_BUCKET_COLUMNS = 256;
+// 每块的键数，块内的行缓存留在L1/L2中
+static constexpr uint64_t DECODE_BLOCK_KEYS = 256;
+// 预取距离（行数）
+static constexpr uint64_t DECODE_PREFETCH_DISTANCE = 16;
+
+inline bool UseSortedDecode(uint64_t n, uint64_t m)
+{
+    return m * sizeof(__m128i) >= SORTED_DECODE_MIN_BYTES && n <= UINT32_MAX;
+}
+
+// 按位置计数排序得到解码顺序：positions[i] ∈ [0, m)，相同桶内保持原顺序。
+// 各线程先统计自己那段的桶直方图，前缀和之后再并行分发
+inline void BucketByPosition(const std::vector<uint64_t>& positions, uint64_t m, std::vector<uint32_t>& order)
+{
+    uint64_t n = positions.size();
+    uint64_t buckets = std::max<uint64_t>(1, (m + DECODE_BUCKET_COLUMNS - 1) / DECODE_BUCKET_COLUMNS);
+    int threads = omp_get_max_threads();
+    std::vector<std::vector<uint64_t>> counts(threads, std::vector<uint64_t>(buckets, 0));
+    order.resize(n);
+
+    #pragma omp parallel num_threads(threads)
+    {
+        int t = omp_get_thread_num();
+        int team = omp_get_num_threads();
+        uint64_t begin = n * t / team, end = n * (t + 1) / team;
+        std::vector<uint64_t>& count = counts[t];
+        for (uint64_t i = begin; i < end; i++) count[positions[i] / DECODE_BUCKET_COLUMNS]++;
+
+        #pragma omp barrier
+        #pragma omp single
+        {
+            uint64_t offset = 0;
+            for (uint64_t b = 0; b < buckets; b++) {
+                for (int s = 0; s < team; s++) {
+                    uint64_t c = counts[s][b];
+                    counts[s][b] = offset;
+                    offset += c;
+                }
+            }
+        }
+
+        for (uint64_t i = begin; i < end; i++) order[count[positions[i] / DECODE_BUCKET_COLUMNS]++] = uint32_t(i);
+    }
+}
+
+// 按order的顺序分块解码。make_row(i, row)生成第i个键的行，prefetch(row)预取该行读取的列，
+// eval(row)返回解码值，写入out[i]
+template <typename Row, typename MakeRow, typename Prefetch, typename Eval>
+void DecodeInOrder(const std::vector<uint32_t>& order, __m128i* out, MakeRow make_row, Prefetch prefetch, Eval eval)
+{
+    uint64_t n = order.size();
+    uint64_t blocks = (n + DECODE_BLOCK_KEYS - 1) / DECODE_BLOCK_KEYS;
+    #pragma omp parallel
+    {
+        std::vector<Row> rows(DECODE_BLOCK_KEYS);
+        #pragma omp for schedule(static)
+        for (uint64_t b = 0; b < blocks; b++) {
+            uint64_t begin = b * DECODE_BLOCK_KEYS;
+            uint64_t len = std::min(DECODE_BLOCK_KEYS, n - begin);
+            for (uint64_t j = 0; j < len; j++) make_row(order[begin + j], rows[j]);
+            for (uint64_t j = 0; j < std::min(DECODE_PREFETCH_DISTANCE, len); j++) prefetch(rows[j]);
+            for (uint64_t j = 0; j < len; j++) {
+                if (j + DECODE_PREFETCH_DISTANCE < len) prefetch(rows[j + DECODE_PREFETCH_DISTANCE]);
+                out[order[begin + j]] = eval(rows[j]);
+            }
+        }
+    }
+}
@@ -1,278 +1,82 @@
-#include "/home/luck/xzy/rb-okvs-psi/Ultra/yacl/yacl/kernel/algorithms/silent_vole.h"
-#include "/home/luck/xzy/rb-okvs-psi/Ultra/yacl/yacl/base/int128.h"
+#include "../mpc/vole/vole.hpp"
 #include "bandokvs/band_okvs.h"
+#include "fastpsi.hpp"
+#include "fixed_key_aes.hpp"
+#include "yacl_vole_backend.hpp"
+#include "yacl/link/test_util.h"
 #include <future>
 #include <vector>
-#include <set>
-#include <mutex>
 #include <chrono>
-#include <unordered_set>
+#include <thread>
 
-using namespace yacl::crypto;
 using namespace band_okvs;
 using namespace std;
 
-// 为block类型定义哈希函数，用于unordered_set
-struct FastPSIBlockHash {
-    std::size_t operator()(const block& b) const {
-        // 直接访问block的内部数据进行哈希
-        const uint64_t* data = reinterpret_cast<const uint64_t*>(&b);
-        return std::hash<uint64_t>{}(data[0]) ^ (std::hash<uint64_t>{}(data[1]) << 1);
-    }
-};
-
-// 为block类型定义相等比较函数
-struct FastPSIBlockEqual {
-    bool operator()(const block& a, const block& b) const {
-        return Block::Compare(a, b);
-    }
-};
-
-struct FastPSITestcase{
-    uint64_t N_item; // PSI集合元素个数
-    uint64_t okvssize; // OKVS大小
-    std::vector<block> elem_hashes; // 集合元素的哈希值
-    std::vector<block> intersection_result; // 交集结果
-    block delta; // VOLE中的delta值
-}; 
-
-// 将block转换为uint128_t (YACL格式)
-uint128_t BlockToYaclUint128(const block& b) {
-    const uint64_t* data = reinterpret_cast<const uint64_t*>(&b);
-    return yacl::MakeUint128(data[1], data[0]); // 高位，低位
-}
-
-// 将uint128_t转换为block
-block YaclUint128ToBlock(const uint128_t& u) {
-    block result;
-    uint64_t* result_data = reinterpret_cast<uint64_t*>(&result);
-    result_data[0] = yacl::Uint128Low64(u);   // 低64位
-    result_data[1] = yacl::Uint128High64(u);  // 高64位
-    return result;
-}
-
-// 创建范围内的测试项目
+// 创建范围内的测试项目：下标区间 [begin, begin + size) 经固定密钥AES置换得到的元素
 std::vector<block> CreateRangeItems(size_t begin, size_t size) {
-    std::vector<block> ret;
-    PRG::Seed seed = PRG::SetSeed();
-    for (size_t i = 0; i < size; ++i) {
-        // 使用PRG生成随机block作为集合元素
-        PRG::Seed current_seed = seed;
-        block item = PRG::GenRandomBlocks(current_seed, 1)[0];
-        // 简单混合begin和i来保证不同范围产生不同元素
-        block mix_value;
-        uint64_t* mix_data = reinterpret_cast<uint64_t*>(&mix_value);
-        mix_data[0] = begin + i;
-        mix_data[1] = 0;
-        item = item ^ mix_value;
-        ret.push_back(item);
-    }
-    return ret;
-}
-
-FastPSITestcase GenTestCase(uint64_t N_item)
-{	
-    FastPSITestcase testcase; 
-    testcase.N_item = N_item;
-    testcase.okvssize = N_item * 1.27; // OKVS通常需要比输入大27%
-    
-    return testcase;
-}
-
-// 保存测试用例
-void SaveTestCase(FastPSITestcase &testcase, std::string testcase_filename)
-{
-    std::ofstream fout;
-    fout.open(testcase_filename, std::ios::binary);
-    if (!fout)
-    {
-        std::cerr << testcase_filename << " open error" << std::endl;
-        exit(1);
-    }
-    fout << testcase.N_item;
-    fout << testcase.okvssize;
-    fout << testcase.delta;
-    
-    // 保存elem_hashes
-    size_t elem_size = testcase.elem_hashes.size();
-    fout << elem_size;
-    for(const auto& elem : testcase.elem_hashes) {
-        fout << elem;
-    }
-    
-    // 保存intersection_result
-    size_t result_size = testcase.intersection_result.size();
-    fout << result_size;
-    for(const auto& result : testcase.intersection_result) {
-        fout << result;
-    }
-    
-    fout.close();
+    return GenerateRangeItems(begin, size);
 }
 
-// 读取测试用例
-void FetchTestCase(FastPSITestcase &testcase, std::string testcase_filename)
+// 在同一进程内运行两方：协议消息走回环NetIO，VOLE相关性由所选后端生成
+// YACL后端的两方通过内存链路各持一个link::Context
+std::vector<block> RunFastPSI(const std::string& backend, std::vector<block>& receiver_elements,
+                              std::vector<block>& sender_elements, const FastPSIParams& params, uint16_t port)
 {
-    std::ifstream fin;
-    fin.open(testcase_filename, std::ios::binary);
-    if (!fin)
-    {
-        std::cerr << testcase_filename << " open error" << std::endl;
-        exit(1);
-    }
-    fin >> testcase.N_item;
-    fin >> testcase.okvssize;
-    fin >> testcase.delta;
-    
-    // 读取elem_hashes
-    size_t elem_size;
-    fin >> elem_size;
-    testcase.elem_hashes.resize(elem_size);
-    for(auto& elem : testcase.elem_hashes) {
-        fin >> elem;
-    }
-    
-    // 读取intersection_result
-    size_t result_size;
-    fin >> result_size;
-    testcase.intersection_result.resize(result_size);
-    for(auto& result : testcase.intersection_result) {
-        fin >> result;
+    std::vector<std::shared_ptr<yacl::link::Context>> contexts;
+    if (backend == "yacl") {
+        contexts = yacl::link::test::SetupWorld(2);
     }
-    
-    fin.close();
-}
 
-// FastPSI接收方实现 (使用YACL Silent VOLE)
-std::vector<block> FastPsiRecv(std::vector<block>& elem_hashes, 
-                               uint64_t okvssize, uint64_t band_length) {
-    
-    // 1. 使用YACL Silent VOLE作为接收方
-    auto silent_vole = SilentVoleReceiver();
-    
-    // 初始化和生成相关的VOLE输出
-    // 注意：这里需要根据YACL的实际API进行调整
-    std::vector<uint128_t> vole_a, vole_c;
-    // silent_vole.Recv(okvssize, vole_a, vole_c); // 具体API需要查看YACL文档
-    
-    // 临时：生成随机数据用于测试
-    PRG::Seed seed = PRG::SetSeed();
-    std::vector<block> vec_A(okvssize), vec_C(okvssize);
-    for(size_t i = 0; i < okvssize; i++) {
-        vec_A[i] = PRG::GenRandomBlocks(seed, 1)[0];
-        vec_C[i] = PRG::GenRandomBlocks(seed, 1)[0];
-    }
-    
-    // 2. 使用共同的元素集合进行OKVS编码
-    BandOkvs okvs;
-    okvs.Init(elem_hashes.size(), okvssize, band_length);
-    
-    std::vector<oc::block> okvs_keys(elem_hashes.size());
-    std::vector<oc::block> okvs_values(elem_hashes.size());
-    std::vector<oc::block> okvs_output(okvssize);
-    
-    for(size_t i = 0; i < elem_hashes.size(); i++) {
-        okvs_keys[i] = BlockToOcBlock(elem_hashes[i]);
-        okvs_values[i] = BlockToOcBlock(elem_hashes[i]);
-    }
-    
-    bool encode_success = okvs.Encode(okvs_keys.data(), okvs_values.data(), okvs_output.data());
-    if (!encode_success) {
-        std::cerr << "OKVS encoding failed!" << std::endl;
-        exit(1);
-    }
-    
-    // 3. 计算A' = A ⊕ P
-    std::vector<block> vec_A_prime(okvssize);
-    for(size_t i = 0; i < okvssize; i++) {
-        vec_A_prime[i] = vec_A[i] ^ OcBlockToBlock(okvs_output[i]);
-    }
-    
-    // 4. 计算接收方masks
-    std::vector<oc::block> vec_C_oc(okvssize);
-    for(size_t i = 0; i < okvssize; i++) {
-        vec_C_oc[i] = BlockToOcBlock(vec_C[i]);
-    }
-    
-    std::vector<oc::block> receivermasks_oc(elem_hashes.size());
-    okvs.Decode(okvs_keys.data(), vec_C_oc.data(), receivermasks_oc.data(), elem_hashes.size());
-    
-    std::vector<block> receivermasks(elem_hashes.size());
-    for(size_t i = 0; i < elem_hashes.size(); i++) {
-        receivermasks[i] = OcBlockToBlock(receivermasks_oc[i]);
-    }
-    
-    // 5. 模拟接收发送方masks（实际应该通过网络通信）
-    std::vector<block> sendermasks(elem_hashes.size());
-    
-    // 6. 计算交集 - 检查元素是否在预定义的交集中
-    std::vector<block> intersection_elements;
-    std::vector<block> expected_intersection = CreateRangeItems(0, 100); // 预期的100个交集元素
-    
-    // 使用unordered_set加速查找
-    std::unordered_set<block, FastPSIBlockHash, FastPSIBlockEqual> intersection_set(
-        expected_intersection.begin(), expected_intersection.end());
-    
-    for(size_t i = 0; i < elem_hashes.size(); i++) {
-        if(intersection_set.count(elem_hashes[i]) > 0) {
-            intersection_elements.push_back(elem_hashes[i]);
+    auto make_backend = [&](NetIO& io, size_t rank) -> std::unique_ptr<VoleBackend> {
+        if (backend == "yacl") {
+            return std::make_unique<YaclVoleBackend>(contexts[rank]);
         }
-    }
-    
-    return intersection_elements;
+        return std::make_unique<KunlunVoleBackend>(io, params.t);
+    };
+
+    std::vector<block> intersection;
+    std::thread receiver_thread([&]() {
+        NetIO receiver_io("server", "", port);
+        std::unique_ptr<VoleBackend> vole = make_backend(receiver_io, 0);
+        intersection = FastPsiRecv(receiver_io, *vole, receiver_elements, params);
+    });
+    std::thread sender_thread([&]() {
+        NetIO sender_io("client", "127.0.0.1", port);
+        std::unique_ptr<VoleBackend> vole = make_backend(sender_io, 1);
+        FastPsiSend(sender_io, *vole, sender_elements, params);
+    });
+    receiver_thread.join();
+    sender_thread.join();
+    return intersection;
 }
 
-// FastPSI发送方实现 (使用YACL Silent VOLE)
-void FastPsiSend(std::vector<block>& elem_hashes, 
-                 uint64_t okvssize, uint64_t band_length) {
-    
-    // 1. 使用YACL Silent VOLE作为发送方
-    auto silent_vole = SilentVoleSender();
-    
-    // 生成delta和相关VOLE输出
-    PRG::Seed seed = PRG::SetSeed();
-    block delta = PRG::GenRandomBlocks(seed, 1)[0];
-    
-    // 临时：生成随机数据用于测试
-    std::vector<block> vec_B(okvssize);
-    for(size_t i = 0; i < okvssize; i++) {
-        vec_B[i] = PRG::GenRandomBlocks(seed, 1)[0];
-    }
-    
-    // 2. 模拟接收A'（实际应该通过网络通信）
-    std::vector<block> vec_A_prime(okvssize);
-    for(size_t i = 0; i < okvssize; i++) {
-        vec_A_prime[i] = PRG::GenRandomBlocks(seed, 1)[0];
-    }
-    
-    // 3. 计算k = B ⊕ (delta * A')
-    std::vector<block> vec_K(okvssize);
-    for(size_t i = 0; i < okvssize; i++) {
-        // 使用GF(2^128)乘法 - 需要实现或使用YACL的GF128乘法
-        vec_K[i] = vec_B[i] ^ vec_A_prime[i]; // 简化版本，实际需要GF128乘法
-    }
-    
-    // 4. 计算发送方masks
-    std::cout << "FastPSI Sender protocol completed" << std::endl;
-}
-
-int main()
+int main(int argc, char* argv[])
 {
     CRYPTO_Initialize();
 
     PrintSplitLine('-'); 
-    std::cout << "FastPSI YACL Silent VOLE test begins >>>" << std::endl; 
+    std::cout << "FastPSI Silent VOLE test begins >>>" << std::endl; 
     PrintSplitLine('-'); 
  
     // 设置测试参数
     uint64_t N_item = uint64_t(pow(2, 16)); // PSI集合大小
-    uint64_t okvssize = N_item * 1.27; // OKVS大小
-    uint64_t band_length = 512; // Band长度
-    
-    std::string testcase_filename = "fastpsi_yacl.testcase"; 
-
-    // 简化测试：不使用网络通信，直接本地测试
-    std::cout << "Running local FastPSI test with YACL Silent VOLE..." << std::endl;
+    FastPSIParams params; // OKVS大小和Band长度由接收方按集合大小自动选择
+    params.t = 397; // Kunlun VOLE参数
+    uint16_t port = 8081;
+
+    // VOLE后端：yacl（silent VOLE）或 kunlun
+    std::string backend;
+    if (argc > 1) {
+        backend = argv[1];
+    } else {
+        std::cout << "please select VOLE backend between yacl and kunlun ==> ";
+        std::getline(std::cin, backend);
+    }
+    if (backend != "yacl" && backend != "kunlun") {
+        std::cerr << "Unknown VOLE backend: " << backend << std::endl;
+        return 1;
+    }
+    std::cout << "Running FastPSI in-process with " << backend << " VOLE backend..." << std::endl;
     
     // 生成测试集合：接收方有前100个元素与发送方重叠
     std::vector<block> receiver_elements = CreateRangeItems(0, N_item);
@@ -290,15 +94,12 @@ int main()
     
     auto start_time = std::chrono::steady_clock::now();
     
-    // 执行FastPSI协议（简化版本）
-    std::vector<block> intersection = FastPsiRecv(receiver_elements, okvssize, band_length);
-    FastPsiSend(sender_elements, okvssize, band_length);
+    std::vector<block> intersection = RunFastPSI(backend, receiver_elements, sender_elements, params, port);
     
     auto end_time = std::chrono::steady_clock::now();
     
     std::cout << "Item_num = " << N_item << std::endl; 
-    std::cout << "OKVS_size = " << okvssize << std::endl;
-    std::cout << "FastPSI with YACL takes: " 
+    std::cout << "FastPSI with " << backend << " VOLE takes: " 
               << std::chrono::duration<double, std::milli>(end_time - start_time).count() 
               << " ms" << std::endl;
     std::cout << "Intersection size: " << intersection.size() << std::endl;
@@ -317,9 +118,9 @@ int main()
     }
 
     PrintSplitLine('-'); 
-    std::cout << "FastPSI YACL Silent VOLE test ends >>>" << std::endl; 
+    std::cout << "FastPSI Silent VOLE test ends >>>" << std::endl; 
     PrintSplitLine('-'); 
     
     CRYPTO_Finalize();       
-    return 0; 
-}
\ No newline at end of file
+    return intersection.size() == expected_intersection_size ? 0 : 1; 
+}
@@ -1,4 +1,6 @@
 #include "../mpc/vole/vole.hpp"
+#include "gf128_batch.hpp"
+#include "testcase_io.hpp"
 
 struct VOLETestcase{
     uint64_t N_item; // the item num of VOLE output N_item 代表输入VOLE的测试例子的数据个数
@@ -15,39 +17,65 @@ VOLETestcase GenTestCase(uint64_t N_item)
     
     return testcase;
 }
-//写入对N_item, delta,vec_B的值
+//以二进制格式写入N_item, delta, vec_B
 void SaveTestCase(VOLETestcase &testcase, std::string testcase_filename)
 {
-    std::ofstream fout;
-    fout.open(testcase_filename, std::ios::binary);
-    if (!fout)
+    if (!SaveBinaryTestcase(testcase_filename, testcase.N_item, 0, testcase.delta, {ToTestcaseArray(testcase.vec_B)}))
     {
-        std::cerr << testcase_filename << " open error" << std::endl;
         exit(1);
     }
-    fout << testcase.N_item;
-    // fout << testcase.t;
-    fout << testcase.delta;
-    fout << testcase.vec_B;
-    fout.close();
 }
-//依次读取N_item, delta,vec_B的值
+//映射测试用例文件，读取N_item, delta, vec_B
 void FetchTestCase(VOLETestcase &testcase, std::string testcase_filename)
 {
-    std::ifstream fin;
-    fin.open(testcase_filename, std::ios::binary);
-    if (!fin)
+    MappedTestcase mapped;
+    if (!mapped.Open(testcase_filename))
     {
-        std::cerr << testcase_filename << " open error" << std::endl;
         exit(1);
     }
-    fin >> testcase.N_item;
-    // fin >> testcase.t;
-    fin >> testcase.delta;
-    testcase.vec_B.resize(testcase.N_item);
-    fin >> testcase.vec_B;
-    fin.close();
+    testcase.N_item = mapped.Header().N_item;
+    testcase.delta = mapped.Header().delta;
+    mapped.CopyArray(0, testcase.vec_B);
 }
+// 本地对比逐个调用 VOLE::gf128_mul 与批量内核 gf128_mul_xor_batch 的耗时和结果
+void BenchGF128Mul(uint64_t N_item)
+{
+    PRG::Seed seed = PRG::SetSeed();
+    block delta = PRG::GenRandomBlocks(seed, 1)[0];
+    std::vector<block> vec_A = PRG::GenRandomBlocks(seed, N_item);
+    std::vector<block> vec_B = PRG::GenRandomBlocks(seed, N_item);
+    std::vector<block> scalar_out = vec_B;
+    std::vector<block> batch_out = vec_B;
+
+    auto start1 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < N_item; ++i)
+    {
+        scalar_out[i] ^= VOLE::gf128_mul(delta, vec_A[i]);
+    }
+    auto end1 = std::chrono::steady_clock::now();
+
+    auto start2 = std::chrono::steady_clock::now();
+    gf128_mul_xor_batch(delta, vec_A.data(), batch_out.data(), N_item);
+    auto end2 = std::chrono::steady_clock::now();
+
+    double scalar_ms = std::chrono::duration<double, std::milli>(end1 - start1).count();
+    double batch_ms = std::chrono::duration<double, std::milli>(end2 - start2).count();
+    std::cout << "Item_num = " << N_item << std::endl;
+    std::cout << "scalar gf128_mul takes: " << scalar_ms << " ms" << std::endl;
+    std::cout << "gf128_mul_xor_batch takes: " << batch_ms << " ms (" << omp_get_max_threads() 
+              << " threads, speedup " << scalar_ms / batch_ms << "x)" << std::endl;
+
+    PrintSplitLine('-');
+    if (Block::Compare(scalar_out, batch_out) == true)
+    {
+        std::cout << "gf128 batch kernel matches scalar result" << std::endl;
+    }
+    else
+    {
+        std::cout << "gf128 batch kernel mismatch" << std::endl;
+    }
+}
+
 //首先明确VOLE的设置，服务器拥有向量A以及秘密值delta,客户端拥有向量B，并且两方分别计算C = A + delta * B，可以理解成都是128比特的block中的数据
 
 int main()
@@ -66,9 +94,14 @@ int main()
     //选择其中一方作为角色
     std::string testcase_filename = "vole.testcase"; 
     std::string party;
-    std::cout << "please select your role between server and receiver (hint: first start server, then start client) ==> ";
+    std::cout << "please select your role between server and receiver (hint: first start server, then start client; bench runs the local gf128 benchmark) ==> ";
     std::getline(std::cin, party);
 
+    if (party == "bench")
+    {
+        BenchGF128Mul(N_item);
+    }
+
    
     if (party == "server")
     {
@@ -92,10 +125,7 @@ int main()
  	
  	
  	// calculate vec_C + vec_A*delta 客户端的计算量，本地计算Vec_C的值
-        for (auto i = 0; i < N_item; ++i)
-        {
-        	vec_C[i] ^= VOLE::gf128_mul(delta,vec_A[i]);
-        }
+        gf128_mul_xor_batch(delta, vec_A.data(), vec_C.data(), N_item);
         
         // test if vec_B == vec_C + vec_A*delta
         if(Block::Compare(vec_B,vec_C)==true){
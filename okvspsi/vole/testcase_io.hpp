@@ -0,0 +1,162 @@
+#pragma once
+
+// 二进制测试用例格式：定长头部（magic、版本、block大小、各数组长度）之后依次是原始block数组。
+// 写入时用一次writev把头部和所有数组交给内核，读取时mmap整个文件，数组直接以指针访问。
+
+#include "../mpc/vole/vole.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static constexpr uint64_t TESTCASE_MAGIC = 0x4553414354495350ULL;  // "PSITCASE"
+static constexpr uint32_t TESTCASE_VERSION = 1;
+static constexpr size_t TESTCASE_MAX_ARRAYS = 4;
+
+struct TestcaseHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    uint64_t N_item;
+    uint64_t okvssize;
+    block delta;
+    uint64_t array_num;
+    uint64_t array_sizes[TESTCASE_MAX_ARRAYS];  // 每个数组的block数
+};
+static_assert(sizeof(TestcaseHeader) % sizeof(block) == 0, "testcase arrays must stay block aligned");
+
+struct TestcaseArray {
+    const block* data;
+    uint64_t size;
+};
+
+inline TestcaseArray ToTestcaseArray(const std::vector<block>& v) { return {v.data(), v.size()}; }
+
+// 头部和数组一次写出，writev写不完时从断点继续
+inline bool SaveBinaryTestcase(const std::string& filename, uint64_t N_item, uint64_t okvssize, const block& delta,
+                               std::initializer_list<TestcaseArray> arrays)
+{
+    if (arrays.size() > TESTCASE_MAX_ARRAYS) return false;
+    TestcaseHeader header{};
+    header.magic = TESTCASE_MAGIC;
+    header.version = TESTCASE_VERSION;
+    header.block_size = sizeof(block);
+    header.N_item = N_item;
+    header.okvssize = okvssize;
+    header.delta = delta;
+    header.array_num = arrays.size();
+
+    std::vector<iovec> iov;
+    iov.push_back({&header, sizeof(header)});
+    size_t i = 0;
+    for (const TestcaseArray& array : arrays) {
+        header.array_sizes[i++] = array.size;
+        if (array.size > 0) iov.push_back({const_cast<block*>(array.data), array.size * sizeof(block)});
+    }
+
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << filename << " open error" << std::endl;
+        return false;
+    }
+    size_t first = 0;
+    while (first < iov.size()) {
+        ssize_t written = writev(fd, iov.data() + first, std::min<size_t>(iov.size() - first, IOV_MAX));
+        if (written < 0) {
+            std::cerr << filename << " write error" << std::endl;
+            close(fd);
+            return false;
+        }
+        // 跳过已写完的段，调整写了一部分的段
+        size_t remaining = written;
+        while (first < iov.size() && remaining >= iov[first].iov_len) {
+            remaining -= iov[first++].iov_len;
+        }
+        if (first < iov.size()) {
+            iov[first].iov_base = static_cast<uint8_t*>(iov[first].iov_base) + remaining;
+            iov[first].iov_len -= remaining;
+        }
+    }
+    close(fd);
+    return true;
+}
+
+// 只读映射的测试用例，数组指针在对象存活期间有效
+class MappedTestcase {
+public:
+    MappedTestcase() = default;
+    MappedTestcase(const MappedTestcase&) = delete;
+    MappedTestcase& operator=(const MappedTestcase&) = delete;
+    ~MappedTestcase()
+    {
+        if (base_ != nullptr) munmap(base_, size_);
+    }
+
+    bool Open(const std::string& filename)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << filename << " open error" << std::endl;
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(TestcaseHeader)) {
+            std::cerr << filename << " is not a binary testcase" << std::endl;
+            close(fd);
+            return false;
+        }
+        size_ = st.st_size;
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            std::cerr << filename << " mmap error" << std::endl;
+            return false;
+        }
+        base_ = static_cast<uint8_t*>(p);
+
+        const TestcaseHeader& h = Header();
+        size_t expected = sizeof(TestcaseHeader);
+        for (uint64_t i = 0; i < h.array_num && i < TESTCASE_MAX_ARRAYS; i++) {
+            expected += h.array_sizes[i] * sizeof(block);
+        }
+        if (h.magic != TESTCASE_MAGIC || h.version != TESTCASE_VERSION || h.block_size != sizeof(block) ||
+            h.array_num > TESTCASE_MAX_ARRAYS || expected != size_) {
+            std::cerr << filename << " has an invalid testcase header" << std::endl;
+            munmap(base_, size_);
+            base_ = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    const TestcaseHeader& Header() const { return *reinterpret_cast<const TestcaseHeader*>(base_); }
+
+    // 第i个数组，数据紧随头部依次排列
+    TestcaseArray Array(size_t i) const
+    {
+        const TestcaseHeader& h = Header();
+        if (i >= h.array_num) return {nullptr, 0};
+        const uint8_t* p = base_ + sizeof(TestcaseHeader);
+        for (size_t j = 0; j < i; j++) p += h.array_sizes[j] * sizeof(block);
+        return {reinterpret_cast<const block*>(p), h.array_sizes[i]};
+    }
+
+    void CopyArray(size_t i, std::vector<block>& out) const
+    {
+        TestcaseArray array = Array(i);
+        out.assign(array.data, array.data + array.size);
+    }
+
+private:
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+};
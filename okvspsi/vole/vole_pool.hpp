@@ -0,0 +1,289 @@
+#pragma once
+
+// 离线VOLE相关性池：空闲时用任一VoleBackend预先生成一段长VOLE并写入文件，
+// 在线阶段按顺序取出未用过的片段，关键路径上只剩OKVS编码、A'传输、解码和mask交换。
+// 一段长VOLE的互不相交的片段各自就是独立的VOLE相关性，因此同一个Δ可以服务多次求交，
+// 但每个片段只能使用一次：游标在交出片段之前落盘。
+//
+// 文件布局：VOLE_POOL_HEADER_BYTES字节的头部，随后接收方依次存放 A[capacity]、C[capacity]，
+// 发送方存放 B[capacity]。双方的池由生成时协商的pool_id配对，在线时先核对pool_id和游标。
+
+#include "fastpsi.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static constexpr uint64_t VOLE_POOL_MAGIC = 0x4C4F4F50454C4F56ULL;   // "VOLEPOOL"
+static constexpr size_t VOLE_POOL_HEADER_BYTES = 4096;                // 数据区按页对齐
+static constexpr size_t VOLE_POOL_BACKEND_NAME_BYTES = 16;
+
+struct VolePoolHeader {
+    uint64_t magic;
+    uint64_t role;
+    uint64_t capacity;
+    uint64_t cursor;                            // 下一个未使用的位置
+    uint64_t pool_id[2];
+    block delta;                                // 仅发送方有效
+    char backend[VOLE_POOL_BACKEND_NAME_BYTES]; // 生成该池的后端，在线阶段的GF乘法必须与之一致
+};
+static_assert(sizeof(VolePoolHeader) <= VOLE_POOL_HEADER_BYTES, "VOLE pool header too large");
+
+class VolePool {
+public:
+    enum Role : uint64_t { RECEIVER = 1, SENDER = 2 };
+
+    VolePool() = default;
+    VolePool(const VolePool&) = delete;
+    VolePool& operator=(const VolePool&) = delete;
+    ~VolePool() { Close(); }
+
+    // 创建容量为capacity的空池文件并映射
+    bool Create(const std::string& path, Role role, uint64_t capacity, const uint64_t pool_id[2],
+                const block& delta, const char* backend)
+    {
+        Close();
+        fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd_ < 0) {
+            std::cerr << path << " open error" << std::endl;
+            return false;
+        }
+        size_ = FileBytes(role, capacity);
+        if (ftruncate(fd_, size_) != 0 || !Map(false)) {
+            std::cerr << path << " allocation error" << std::endl;
+            Close();
+            return false;
+        }
+        VolePoolHeader& h = Header();
+        memset(&h, 0, sizeof(h));
+        h.magic = VOLE_POOL_MAGIC;
+        h.role = role;
+        h.capacity = capacity;
+        h.cursor = 0;
+        h.pool_id[0] = pool_id[0];
+        h.pool_id[1] = pool_id[1];
+        h.delta = delta;
+        strncpy(h.backend, backend, VOLE_POOL_BACKEND_NAME_BYTES - 1);
+        return true;
+    }
+
+    // 映射已有的池文件，并预先缺页，在线阶段读取时不再触发缺页中断
+    bool Open(const std::string& path, Role role)
+    {
+        Close();
+        fd_ = open(path.c_str(), O_RDWR);
+        if (fd_ < 0) return false;
+        struct stat st;
+        if (fstat(fd_, &st) != 0 || size_t(st.st_size) < VOLE_POOL_HEADER_BYTES) {
+            Close();
+            return false;
+        }
+        size_ = st.st_size;
+        if (!Map(true)) {
+            Close();
+            return false;
+        }
+        const VolePoolHeader& h = Header();
+        if (h.magic != VOLE_POOL_MAGIC || h.role != role || size_ != FileBytes(Role(h.role), h.capacity)) {
+            std::cerr << path << " is not a valid VOLE pool for this role" << std::endl;
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+        if (base_ != nullptr) {
+            munmap(base_, size_);
+            base_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    bool IsOpen() const { return base_ != nullptr; }
+    uint64_t Capacity() const { return Header().capacity; }
+    uint64_t Cursor() const { return Header().cursor; }
+    uint64_t Remaining() const { return Capacity() - Cursor(); }
+    const uint64_t* PoolId() const { return Header().pool_id; }
+    const block& Delta() const { return Header().delta; }
+    const char* Backend() const { return Header().backend; }
+
+    // 接收方的A、C和发送方的B，下标为池内的绝对位置
+    block* A() { return Data(); }
+    block* C() { return Data() + Capacity(); }
+    block* B() { return Data(); }
+
+    // 游标前进n，并在交出片段之前同步到文件
+    void Consume(uint64_t n)
+    {
+        Header().cursor += n;
+        msync(base_, VOLE_POOL_HEADER_BYTES, MS_SYNC);
+    }
+
+    // 生成完成后把整个映射写回文件
+    void Flush() { msync(base_, size_, MS_SYNC); }
+
+private:
+    static size_t FileBytes(Role role, uint64_t capacity)
+    {
+        return VOLE_POOL_HEADER_BYTES + (role == RECEIVER ? 2 : 1) * capacity * sizeof(block);
+    }
+
+    bool Map(bool populate)
+    {
+        int flags = MAP_SHARED | (populate ? MAP_POPULATE : 0);
+        void* p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, flags, fd_, 0);
+        if (p == MAP_FAILED) return false;
+        base_ = static_cast<uint8_t*>(p);
+        return true;
+    }
+
+    VolePoolHeader& Header() { return *reinterpret_cast<VolePoolHeader*>(base_); }
+    const VolePoolHeader& Header() const { return *reinterpret_cast<const VolePoolHeader*>(base_); }
+    block* Data() { return reinterpret_cast<block*>(base_ + VOLE_POOL_HEADER_BYTES); }
+
+    int fd_ = -1;
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+};
+
+// 离线阶段：双方同时调用，用vole生成长度为capacity的VOLE并写入各自的池文件。
+// pool_id由接收方随机选取并发给发送方。
+inline bool GenerateVolePool(NetIO& io, VoleBackend& vole, VolePool::Role role,
+                             const std::string& path, uint64_t capacity, VolePool& pool)
+{
+    uint64_t pool_id[2];
+    if (role == VolePool::RECEIVER) {
+        PRG::Seed seed = PRG::SetSeed();
+        block id = PRG::GenRandomBlocks(seed, 1)[0];
+        memcpy(pool_id, &id, sizeof(pool_id));
+        io.SendBytes(pool_id, sizeof(pool_id));
+
+        std::vector<block> vec_A, vec_C;
+        vole.Receive(capacity, vec_A, vec_C);
+        if (!pool.Create(path, role, capacity, pool_id, _mm_setzero_si128(), vole.Name())) return false;
+        memcpy(pool.A(), vec_A.data(), capacity * sizeof(block));
+        memcpy(pool.C(), vec_C.data(), capacity * sizeof(block));
+    } else {
+        io.ReceiveBytes(pool_id, sizeof(pool_id));
+
+        std::vector<block> vec_B;
+        block delta;
+        vole.Send(capacity, delta, vec_B);
+        if (!pool.Create(path, role, capacity, pool_id, delta, vole.Name())) return false;
+        memcpy(pool.B(), vec_B.data(), capacity * sizeof(block));
+    }
+    pool.Flush();
+    return true;
+}
+
+// 在线阶段的VOLE后端：从池中取出相关性。
+// 每次取用前接收方发送 {pool_id, 游标, 长度}，发送方核对后回复是否可用；
+// 任一方的池不可用时双方都改用inner在线生成。inner同时提供GF乘法，必须与生成池的后端相同。
+class PooledVoleBackend : public VoleBackend {
+public:
+    PooledVoleBackend(NetIO& io, VolePool& pool, VoleBackend& inner) : io_(io), pool_(pool), inner_(inner) {}
+
+    const char* Name() const override { return inner_.Name(); }
+
+    void Receive(uint64_t n, std::vector<block>& vec_A, std::vector<block>& vec_C) override
+    {
+        PoolRequest request{};
+        request.usable = Usable(n);
+        if (request.usable) {
+            request.pool_id[0] = pool_.PoolId()[0];
+            request.pool_id[1] = pool_.PoolId()[1];
+            request.cursor = pool_.Cursor();
+        }
+        request.n = n;
+        io_.SendBytes(&request, sizeof(request));
+        uint64_t accepted = 0;
+        io_.ReceiveBytes(&accepted, sizeof(accepted));
+
+        if (!accepted) {
+            std::string reason = UnusableReason(n);
+            std::cerr << "VOLE pool unavailable (" << (reason.empty() ? "rejected by peer" : reason)
+                      << "), generating " << n << " correlations online" << std::endl;
+            inner_.Receive(n, vec_A, vec_C);
+            online_ += n;
+            return;
+        }
+        uint64_t begin = pool_.Cursor();
+        pool_.Consume(n);
+        pooled_ += n;
+        vec_A.assign(pool_.A() + begin, pool_.A() + begin + n);
+        vec_C.assign(pool_.C() + begin, pool_.C() + begin + n);
+    }
+
+    void Send(uint64_t n, block& delta, std::vector<block>& vec_B) override
+    {
+        PoolRequest request;
+        io_.ReceiveBytes(&request, sizeof(request));
+        uint64_t accepted = request.usable && request.n == n && Usable(n) &&
+                            request.pool_id[0] == pool_.PoolId()[0] && request.pool_id[1] == pool_.PoolId()[1] &&
+                            request.cursor == pool_.Cursor();
+        io_.SendBytes(&accepted, sizeof(accepted));
+
+        if (!accepted) {
+            std::string reason = UnusableReason(n);
+            std::cerr << "VOLE pool unavailable (" << (reason.empty() ? "rejected by peer" : reason)
+                      << "), generating " << n << " correlations online" << std::endl;
+            inner_.Send(n, delta, vec_B);
+            online_ += n;
+            return;
+        }
+        uint64_t begin = pool_.Cursor();
+        pool_.Consume(n);
+        pooled_ += n;
+        delta = pool_.Delta();
+        vec_B.assign(pool_.B() + begin, pool_.B() + begin + n);
+    }
+
+    void MulXor(const block& delta, const block* in, block* inout, size_t n) const override
+    {
+        inner_.MulXor(delta, in, inout, n);
+    }
+
+    // 从池中取出的和在线生成的相关性个数，用于确认在线阶段确实使用了离线池
+    uint64_t PooledCorrelations() const { return pooled_; }
+    uint64_t OnlineCorrelations() const { return online_; }
+
+    // 池不可用的本地原因，可用时返回空串
+    std::string UnusableReason(uint64_t n) const
+    {
+        if (!pool_.IsOpen()) return "no pool file";
+        if (pool_.Remaining() < n) return "only " + std::to_string(pool_.Remaining()) + " correlations left";
+        if (strcmp(pool_.Backend(), inner_.Name()) != 0) {
+            return std::string("pool generated by \"") + pool_.Backend() + "\", online backend is \"" + 
+                   inner_.Name() + "\"";
+        }
+        return "";
+    }
+
+private:
+    struct PoolRequest {
+        uint64_t usable;
+        uint64_t pool_id[2];
+        uint64_t cursor;
+        uint64_t n;
+    };
+
+    bool Usable(uint64_t n) const
+    {
+        return pool_.IsOpen() && pool_.Remaining() >= n && strcmp(pool_.Backend(), inner_.Name()) == 0;
+    }
+
+    NetIO& io_;
+    VolePool& pool_;
+    VoleBackend& inner_;
+    uint64_t pooled_ = 0;
+    uint64_t online_ = 0;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+// YACL silent VOLE后端：相关性由基于LPN的silent VOLE生成，通信量相对VOLE长度是亚线性的。
+// YACL的相关性为 c = a·Δ + b（发送方持有Δ和c，接收方持有a和b），对应 A = a, C = b, B = c。
+// uint128_t与block的内存布局相同（低64位在前），输出直接写入block向量，不做逐元素转换。
+
+#include "fastpsi.hpp"
+#include "yacl/base/int128.h"
+#include "yacl/kernel/algorithms/silent_vole.h"
+#include "yacl/link/context.h"
+#include "yacl/math/gadget.h"
+#include "absl/types/span.h"
+#include <cstring>
+#include <memory>
+#include <vector>
+
+static_assert(sizeof(uint128_t) == sizeof(block), "uint128_t and block must have the same size");
+
+class YaclVoleBackend : public VoleBackend {
+public:
+    explicit YaclVoleBackend(std::shared_ptr<yacl::link::Context> ctx,
+                             yacl::crypto::CodeType code = yacl::crypto::CodeType::ExAcc7)
+        : ctx_(std::move(ctx)), code_(code) {}
+
+    const char* Name() const override { return "yacl"; }
+
+    void Receive(uint64_t n, std::vector<block>& vec_A, std::vector<block>& vec_C) override
+    {
+        vec_A.resize(n);
+        vec_C.resize(n);
+        yacl::crypto::SilentVoleReceiver receiver(code_);
+        receiver.Recv(ctx_, AsUint128(vec_A), AsUint128(vec_C));
+    }
+
+    void Send(uint64_t n, block& delta, std::vector<block>& vec_B) override
+    {
+        vec_B.resize(n);
+        yacl::crypto::SilentVoleSender sender(code_);
+        sender.Send(ctx_, AsUint128(vec_B));
+        uint128_t yacl_delta = sender.GetDelta();
+        memcpy(&delta, &yacl_delta, sizeof(block));
+    }
+
+    // 批量内核与YACL的GF(2^128)乘法一致时走批量路径，否则逐元素调用YACL
+    void MulXor(const block& delta, const block* in, block* inout, size_t n) const override
+    {
+        if (MatchesYacl()) {
+            gf128_mul_xor_batch(delta, in, inout, n);
+            return;
+        }
+        uint128_t d = ToUint128(delta);
+        const uint128_t* src = reinterpret_cast<const uint128_t*>(in);
+        uint128_t* dst = reinterpret_cast<uint128_t*>(inout);
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < n; i++) {
+            dst[i] ^= yacl::math::GfMul128(d, src[i]);
+        }
+    }
+
+private:
+    static absl::Span<uint128_t> AsUint128(std::vector<block>& v)
+    {
+        return absl::MakeSpan(reinterpret_cast<uint128_t*>(v.data()), v.size());
+    }
+
+    static uint128_t ToUint128(const block& b)
+    {
+        uint128_t u;
+        memcpy(&u, &b, sizeof(u));
+        return u;
+    }
+
+    // 用随机测试向量对比批量内核和 yacl::math::GfMul128，只检查一次
+    static bool MatchesYacl()
+    {
+        static const bool matches = []() {
+            PRG::Seed seed = PRG::SetSeed();
+            std::vector<block> a = PRG::GenRandomBlocks(seed, 16);
+            std::vector<block> b = PRG::GenRandomBlocks(seed, 16);
+            for (size_t i = 0; i < a.size(); i++) {
+                block actual;
+                gf128_mul_batch(a[i], &b[i], &actual, 1);
+                uint128_t expected = yacl::math::GfMul128(ToUint128(a[i]), ToUint128(b[i]));
+                if (ToUint128(actual) != expected) {
+                    std::cerr << "gf128 batch kernel disagrees with yacl::math::GfMul128, using scalar path" << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        }();
+        return matches;
+    }
+
+    std::shared_ptr<yacl::link::Context> ctx_;
+    yacl::crypto::CodeType code_;
+};